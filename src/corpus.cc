@@ -0,0 +1,573 @@
+/* ner: src/corpus.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* ner-corpus: Generates a synthetic mail corpus for benchmarking ner.
+ *
+ * The same seed and options always produce the same Maildir, which is then
+ * indexed with libnotmuch. A notmuch configuration file for the corpus is
+ * written alongside it, for use with NOTMUCH_CONFIG. */
+
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <cctype>
+#include <ctime>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <notmuch.h>
+
+struct Options
+{
+    std::string output;
+    unsigned seed;
+    unsigned threads;
+    unsigned messages;
+    unsigned depth;
+    unsigned htmlPercent;
+    unsigned attachmentPercent;
+    unsigned attachmentSize;
+    unsigned longLinePercent;
+    unsigned tags;
+    unsigned tagsPerMessage;
+};
+
+struct MessageInfo
+{
+    unsigned thread;
+    unsigned depth;
+    int parent;
+    std::string subject;
+};
+
+const char * words[] = {
+    "the", "of", "and", "to", "in", "is", "that", "for", "it", "as", "was", "with",
+    "be", "by", "on", "not", "he", "this", "are", "or", "his", "from", "at",
+    "which", "but", "have", "an", "had", "they", "you", "were", "their", "one",
+    "all", "we", "can", "her", "has", "there", "been", "if", "more", "when",
+    "will", "would", "who", "so", "no", "patch", "build", "release", "review",
+    "database", "thread", "message", "search", "index", "terminal", "window",
+    "benchmark", "latency", "regression", "configuration", "libnotmuch",
+    "über", "naïve", "café", "日本語", "résumé"
+};
+
+const unsigned wordCount = sizeof(words) / sizeof(words[0]);
+
+const char * names[] = {
+    "Alice Example", "Bob Example", "Carol Example", "Dave Example",
+    "Erin Example", "Frank Example", "Grace Example", "Heidi Example"
+};
+
+const unsigned nameCount = sizeof(names) / sizeof(names[0]);
+
+class Generator
+{
+    public:
+        Generator(const Options & options)
+            : _options(options), _random(options.seed)
+        {
+        }
+
+        void run();
+
+    private:
+        unsigned uniform(unsigned max)
+        {
+            return std::uniform_int_distribution<unsigned>(0, max - 1)(_random);
+        }
+
+        bool chance(unsigned percent)
+        {
+            return uniform(100) < percent;
+        }
+
+        std::string messageId(unsigned index) const
+        {
+            return std::to_string(index + 1) + "@corpus.ner.invalid";
+        }
+
+        std::string sentence(unsigned length);
+        std::string paragraphs(unsigned count);
+        std::string address(unsigned index) const;
+        std::string body(unsigned index);
+
+        void planMessages();
+        void writeMessage(unsigned index, const std::string & path);
+        void writeConfig(const std::string & mailPath) const;
+        void index(const std::string & mailPath);
+
+        const Options & _options;
+        std::mt19937 _random;
+
+        std::vector<MessageInfo> _messages;
+        std::vector<std::string> _files;
+};
+
+std::string Generator::sentence(unsigned length)
+{
+    std::string sentence;
+
+    for (unsigned i = 0; i < length; ++i)
+    {
+        if (i > 0)
+            sentence += ' ';
+
+        sentence += words[uniform(wordCount)];
+    }
+
+    if (!sentence.empty())
+        sentence[0] = std::toupper(static_cast<unsigned char>(sentence[0]));
+
+    return sentence;
+}
+
+std::string Generator::paragraphs(unsigned count)
+{
+    std::string text;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        /* Wrap roughly as a mail client would */
+        unsigned column = 0;
+        std::istringstream paragraph(sentence(20 + uniform(80)) + '.');
+        std::string word;
+
+        while (paragraph >> word)
+        {
+            if (column > 0 && column + word.size() > 72)
+            {
+                text += '\n';
+                column = 0;
+            }
+            else if (column > 0)
+            {
+                text += ' ';
+                ++column;
+            }
+
+            text += word;
+            column += word.size();
+        }
+
+        text += "\n\n";
+    }
+
+    return text;
+}
+
+std::string Generator::address(unsigned index) const
+{
+    std::string name(names[index % nameCount]);
+    std::string local(name.substr(0, name.find(' ')));
+
+    for (auto c = local.begin(), e = local.end(); c != e; ++c)
+        *c = std::tolower(static_cast<unsigned char>(*c));
+
+    return name + " <" + local + "@example.invalid>";
+}
+
+std::string Generator::body(unsigned index)
+{
+    const MessageInfo & message = _messages.at(index);
+
+    std::string text;
+
+    /* Quote part of the parent, as replies usually do */
+    if (message.parent >= 0)
+        text += "> " + sentence(10 + uniform(20)) + "\n>\n> " + sentence(10 + uniform(20)) + "\n\n";
+
+    text += paragraphs(1 + uniform(6));
+
+    if (chance(_options.longLinePercent))
+    {
+        /* A single very long line, such as a log excerpt or a URL */
+        std::string line;
+        size_t length = 4096 + uniform(16384);
+
+        while (line.size() < length)
+            line += words[uniform(wordCount)];
+
+        text += line + "\n\n";
+    }
+
+    text += "-- \n" + std::string(names[index % nameCount]) + "\n";
+
+    return text;
+}
+
+void Generator::planMessages()
+{
+    unsigned threads = std::max(1u, std::min(_options.threads, _options.messages));
+
+    std::vector<std::vector<unsigned>> threadMessages(threads);
+
+    _messages.reserve(_options.messages);
+
+    for (unsigned index = 0; index < _options.messages; ++index)
+    {
+        MessageInfo message;
+
+        if (index < threads)
+            message.thread = index;
+        else
+        {
+            /* Skew replies towards a few long threads */
+            double position = std::uniform_real_distribution<double>(0, 1)(_random);
+            message.thread = std::min<unsigned>(threads - 1, position * position * threads);
+        }
+
+        std::vector<unsigned> & siblings = threadMessages.at(message.thread);
+
+        if (siblings.empty())
+        {
+            message.depth = 0;
+            message.parent = -1;
+            message.subject = sentence(3 + uniform(8));
+        }
+        else
+        {
+            /* Usually reply to the latest message, otherwise to any earlier one */
+            unsigned parent = chance(70) ? siblings.back() : siblings.at(uniform(siblings.size()));
+
+            while (_messages.at(parent).depth + 1 > _options.depth && _messages.at(parent).parent >= 0)
+                parent = _messages.at(parent).parent;
+
+            message.depth = _messages.at(parent).depth + 1;
+            message.parent = parent;
+            message.subject = "Re: " + _messages.at(siblings.front()).subject;
+        }
+
+        siblings.push_back(index);
+        _messages.push_back(message);
+    }
+}
+
+void Generator::writeMessage(unsigned index, const std::string & path)
+{
+    const MessageInfo & message = _messages.at(index);
+
+    std::ofstream file(path);
+
+    if (!file)
+        throw std::runtime_error("Could not write " + path);
+
+    /* One message every ten minutes, starting in 2010 */
+    time_t date = 1262304000 + static_cast<time_t>(index) * 600;
+    char dateString[64];
+    std::strftime(dateString, sizeof(dateString), "%a, %d %b %Y %H:%M:%S +0000", std::gmtime(&date));
+
+    file << "From: " << address(uniform(nameCount)) << "\n"
+        << "To: " << address(uniform(nameCount)) << "\n"
+        << "Subject: " << message.subject << "\n"
+        << "Date: " << dateString << "\n"
+        << "Message-ID: <" << messageId(index) << ">\n";
+
+    if (message.parent >= 0)
+    {
+        file << "In-Reply-To: <" << messageId(message.parent) << ">\n"
+            << "References:";
+
+        std::vector<unsigned> ancestors;
+
+        for (int parent = message.parent; parent >= 0; parent = _messages.at(parent).parent)
+            ancestors.push_back(parent);
+
+        for (auto ancestor = ancestors.rbegin(), e = ancestors.rend(); ancestor != e; ++ancestor)
+            file << " <" << messageId(*ancestor) << ">";
+
+        file << "\n";
+    }
+
+    file << "MIME-Version: 1.0\n";
+
+    std::string text = body(index);
+    bool html = chance(_options.htmlPercent);
+    bool attachment = chance(_options.attachmentPercent);
+
+    std::string mixedBoundary = "=-mixed-" + std::to_string(index);
+    std::string alternativeBoundary = "=-alternative-" + std::to_string(index);
+
+    if (attachment)
+    {
+        file << "Content-Type: multipart/mixed; boundary=\"" << mixedBoundary << "\"\n\n"
+            << "--" << mixedBoundary << "\n";
+    }
+
+    if (html)
+    {
+        file << "Content-Type: multipart/alternative; boundary=\"" << alternativeBoundary << "\"\n\n"
+            << "--" << alternativeBoundary << "\n";
+    }
+
+    file << "Content-Type: text/plain; charset=utf-8\n"
+        << "Content-Transfer-Encoding: 8bit\n\n"
+        << text;
+
+    if (html)
+    {
+        file << "\n--" << alternativeBoundary << "\n"
+            << "Content-Type: text/html; charset=utf-8\n"
+            << "Content-Transfer-Encoding: 8bit\n\n"
+            << "<html><head><style>p { margin: 0 }</style></head><body>\n";
+
+        std::istringstream paragraphs(text);
+        std::string line;
+
+        while (std::getline(paragraphs, line))
+        {
+            if (line.empty())
+                continue;
+
+            file << "<p><span style=\"font-family: sans-serif\">" << line << "</span></p>\n"
+                << "<table><tr><td><a href=\"https://example.invalid/\">" << words[uniform(wordCount)]
+                << "</a></td></tr></table>\n";
+        }
+
+        file << "</body></html>\n"
+            << "\n--" << alternativeBoundary << "--\n";
+    }
+
+    if (attachment)
+    {
+        static const char base64[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        file << "\n--" << mixedBoundary << "\n"
+            << "Content-Type: application/octet-stream; name=\"attachment-" << index << ".bin\"\n"
+            << "Content-Disposition: attachment; filename=\"attachment-" << index << ".bin\"\n"
+            << "Content-Transfer-Encoding: base64\n\n";
+
+        /* Random data only needs to look like base64, 76 characters a line */
+        unsigned length = _options.attachmentSize * 1024 * 4 / 3;
+        std::string line(76, 'A');
+
+        for (unsigned written = 0; written < length; written += line.size())
+        {
+            for (auto c = line.begin(), e = line.end(); c != e; ++c)
+                *c = base64[uniform(64)];
+
+            file << line << "\n";
+        }
+
+        file << "\n--" << mixedBoundary << "--\n";
+    }
+}
+
+void Generator::writeConfig(const std::string & mailPath) const
+{
+    std::string path = _options.output + "/notmuch-config";
+    std::ofstream config(path);
+
+    if (!config)
+        throw std::runtime_error("Could not write " + path);
+
+    config << "[database]\n"
+        << "path=" << mailPath << "\n\n"
+        << "[user]\n"
+        << "name=" << names[0] << "\n"
+        << "primary_email=alice@example.invalid\n\n"
+        << "[new]\n"
+        << "tags=unread;inbox;\n\n"
+        << "[maildir]\n"
+        << "synchronize_flags=false\n";
+}
+
+void Generator::index(const std::string & mailPath)
+{
+    notmuch_database_t * database;
+
+    notmuch_status_t status = notmuch_database_create(mailPath.c_str(), &database);
+
+    if (status != NOTMUCH_STATUS_SUCCESS)
+        throw std::runtime_error(std::string("Could not create database: ") + notmuch_status_to_string(status));
+
+    const unsigned batchSize = 1000;
+
+    for (unsigned index = 0; index < _files.size(); ++index)
+    {
+        if (index % batchSize == 0)
+        {
+            if (index > 0)
+            {
+                notmuch_database_end_atomic(database);
+                std::cerr << "Indexed " << index << " of " << _files.size() << " messages\r";
+            }
+
+            notmuch_database_begin_atomic(database);
+        }
+
+        notmuch_message_t * message;
+        status = notmuch_database_add_message(database, _files[index].c_str(), &message);
+
+        if (status != NOTMUCH_STATUS_SUCCESS && status != NOTMUCH_STATUS_DUPLICATE_MESSAGE_ID)
+        {
+            std::cerr << "Could not index " << _files[index] << ": "
+                << notmuch_status_to_string(status) << std::endl;
+            continue;
+        }
+
+        notmuch_message_freeze(message);
+
+        if (index >= _files.size() / 2)
+        {
+            notmuch_message_add_tag(message, "inbox");
+
+            if (chance(30))
+                notmuch_message_add_tag(message, "unread");
+        }
+
+        for (unsigned i = 0; i < _options.tagsPerMessage && _options.tags > 0; ++i)
+            notmuch_message_add_tag(message, ("tag" + std::to_string(uniform(_options.tags))).c_str());
+
+        notmuch_message_thaw(message);
+        notmuch_message_destroy(message);
+    }
+
+    if (!_files.empty())
+        notmuch_database_end_atomic(database);
+
+    std::cerr << "Indexed " << _files.size() << " messages" << std::endl;
+
+    notmuch_database_destroy(database);
+}
+
+void Generator::run()
+{
+    std::string mailPath = _options.output + "/mail";
+
+    const char * directories[] = { "", "/mail", "/mail/cur", "/mail/new", "/mail/tmp" };
+
+    for (auto directory = std::begin(directories), e = std::end(directories); directory != e; ++directory)
+    {
+        std::string path = _options.output + *directory;
+
+        if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+            throw std::runtime_error("Could not create " + path);
+    }
+
+    planMessages();
+
+    _files.reserve(_messages.size());
+
+    for (unsigned index = 0; index < _messages.size(); ++index)
+    {
+        std::string path = mailPath + "/cur/" + std::to_string(index + 1) + ".corpus:2,S";
+        writeMessage(index, path);
+        _files.push_back(path);
+    }
+
+    writeConfig(mailPath);
+    index(mailPath);
+}
+
+void usage(const char * program)
+{
+    std::cerr << "Usage: " << program << " --output DIR [OPTIONS]\n\n"
+        << "Options:\n"
+        << "  --seed N                 Random seed (default 1)\n"
+        << "  --threads N              Number of threads (default 1000)\n"
+        << "  --messages N             Number of messages (default 10000)\n"
+        << "  --depth N                Maximum reply depth (default 8)\n"
+        << "  --html PERCENT           Messages with an HTML alternative (default 30)\n"
+        << "  --attachments PERCENT    Messages with an attachment (default 5)\n"
+        << "  --attachment-size KB     Size of each attachment (default 512)\n"
+        << "  --long-lines PERCENT     Messages with a very long line (default 5)\n"
+        << "  --tags N                 Number of distinct extra tags (default 50)\n"
+        << "  --tags-per-message N     Extra tags on each message (default 3)\n"
+        << "  --help                   Show this message\n";
+}
+
+int main(int argc, char * argv[])
+{
+    Options options = { std::string(), 1, 1000, 10000, 8, 30, 5, 512, 5, 50, 3 };
+
+    const struct option longOptions[] = {
+        { "output",             required_argument, NULL, 'o' },
+        { "seed",               required_argument, NULL, 's' },
+        { "threads",            required_argument, NULL, 't' },
+        { "messages",           required_argument, NULL, 'm' },
+        { "depth",              required_argument, NULL, 'd' },
+        { "html",               required_argument, NULL, 'h' },
+        { "attachments",        required_argument, NULL, 'a' },
+        { "attachment-size",    required_argument, NULL, 'A' },
+        { "long-lines",         required_argument, NULL, 'l' },
+        { "tags",               required_argument, NULL, 'g' },
+        { "tags-per-message",   required_argument, NULL, 'G' },
+        { "help",               no_argument,       NULL, 'H' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int option;
+
+    while ((option = getopt_long(argc, argv, "o:", longOptions, NULL)) != -1)
+    {
+        unsigned value = optarg ? std::strtoul(optarg, NULL, 10) : 0;
+
+        switch (option)
+        {
+            case 'o': options.output = optarg; break;
+            case 's': options.seed = value; break;
+            case 't': options.threads = value; break;
+            case 'm': options.messages = value; break;
+            case 'd': options.depth = value; break;
+            case 'h': options.htmlPercent = value; break;
+            case 'a': options.attachmentPercent = value; break;
+            case 'A': options.attachmentSize = value; break;
+            case 'l': options.longLinePercent = value; break;
+            case 'g': options.tags = value; break;
+            case 'G': options.tagsPerMessage = value; break;
+            case 'H':
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (options.output.empty())
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        Generator(options).run();
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
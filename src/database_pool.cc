@@ -0,0 +1,211 @@
+/* ner: src/database_pool.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iomanip>
+
+#include "database_pool.hh"
+#include "notmuch.hh"
+
+/* The most handles open at once */
+const unsigned maxHandles = 4;
+
+DatabasePool * DatabasePool::_instance = 0;
+
+DatabasePool::Handle::Handle(DatabasePool & pool, notmuch_database_t * database,
+    unsigned generation)
+    : _pool(&pool), _database(database), _generation(generation)
+{
+}
+
+DatabasePool::Handle::Handle(Handle && other)
+    : _pool(other._pool), _database(other._database), _generation(other._generation)
+{
+    other._database = NULL;
+}
+
+DatabasePool::Handle::~Handle()
+{
+    if (_database)
+        _pool->release(_database, _generation);
+}
+
+notmuch_database_t * DatabasePool::Handle::get() const
+{
+    return _database;
+}
+
+void DatabasePool::Handle::reopen()
+{
+    {
+        std::lock_guard<std::mutex> lock(_pool->_mutex);
+        _generation = _pool->_generation;
+        ++_pool->_statistics.reopens;
+    }
+
+    notmuch_database_destroy(_database);
+    _database = NULL;
+
+    try
+    {
+        _database = _pool->open();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(_pool->_mutex);
+        --_pool->_open;
+        _pool->_condition.notify_one();
+
+        throw;
+    }
+}
+
+DatabasePool::DatabasePool()
+    : _open(0), _generation(0),
+        _statistics{ 0, 0, 0, std::chrono::microseconds(0), std::chrono::microseconds(0) }
+{
+    _instance = this;
+}
+
+DatabasePool::~DatabasePool()
+{
+    for (auto handle = _idle.begin(), e = _idle.end(); handle != e; ++handle)
+        notmuch_database_destroy(handle->database);
+
+    _instance = 0;
+}
+
+DatabasePool::Handle DatabasePool::acquire()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (_idle.empty() && _open >= maxHandles)
+        _condition.wait(lock);
+
+    return checkOut(lock);
+}
+
+std::unique_ptr<DatabasePool::Handle> DatabasePool::tryAcquire()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_idle.empty() && _open >= maxHandles)
+        return std::unique_ptr<Handle>();
+
+    return std::unique_ptr<Handle>(new Handle(checkOut(lock)));
+}
+
+DatabasePool::Handle DatabasePool::checkOut(std::unique_lock<std::mutex> & lock)
+{
+    unsigned generation = _generation;
+    notmuch_database_t * stale = NULL;
+
+    if (!_idle.empty())
+    {
+        IdleHandle handle = _idle.back();
+        _idle.pop_back();
+
+        if (handle.generation == generation)
+        {
+            ++_statistics.hits;
+            return Handle(*this, handle.database, generation);
+        }
+
+        stale = handle.database;
+        ++_statistics.reopens;
+    }
+    else
+    {
+        ++_open;
+        ++_statistics.misses;
+    }
+
+    lock.unlock();
+
+    if (stale)
+        notmuch_database_destroy(stale);
+
+    try
+    {
+        return Handle(*this, open(), generation);
+    }
+    catch (...)
+    {
+        lock.lock();
+        --_open;
+        _condition.notify_one();
+
+        throw;
+    }
+}
+
+void DatabasePool::invalidate()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_generation;
+}
+
+DatabasePool::Statistics DatabasePool::statistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _statistics;
+}
+
+void DatabasePool::Statistics::report(std::ostream & stream) const
+{
+    auto milliseconds = [](std::chrono::microseconds duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    stream << std::right << std::setw(8) << "hits" << std::setw(8) << "misses"
+        << std::setw(8) << "reopens" << std::setw(10) << "open" << std::setw(10) << "max open"
+        << std::endl;
+
+    stream << std::fixed << std::setprecision(1)
+        << std::setw(8) << hits << std::setw(8) << misses << std::setw(8) << reopens
+        << std::setw(10) << milliseconds(openTime) << std::setw(10) << milliseconds(maxOpenTime)
+        << std::endl;
+}
+
+notmuch_database_t * DatabasePool::open()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    notmuch_database_t * database = Notmuch::openDatabase(NOTMUCH_DATABASE_MODE_READ_ONLY);
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _statistics.openTime += duration;
+    _statistics.maxOpenTime = std::max(_statistics.maxOpenTime, duration);
+
+    return database;
+}
+
+void DatabasePool::release(notmuch_database_t * database, unsigned generation)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _idle.push_back(IdleHandle{ database, generation });
+    _condition.notify_one();
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -0,0 +1,166 @@
+/* ner: src/database_pool.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_DATABASE_POOL_H
+#define NER_DATABASE_POOL_H 1
+
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <notmuch.h>
+
+/**
+ * Keeps read-only database handles open for background threads.
+ *
+ * Threads check a handle out with acquire, and it goes back to the pool when
+ * they are done with it. At most a few handles are open at once; further
+ * threads wait for one to be returned. When the database changes, handles
+ * are reopened as they are next checked out.
+ *
+ * This class is a singleton.
+ */
+class DatabasePool
+{
+    public:
+        struct Statistics
+        {
+            /* Check outs served by an open, up to date handle */
+            unsigned hits;
+
+            /* Check outs which had to open a new handle */
+            unsigned misses;
+
+            /* Handles reopened because the database changed */
+            unsigned reopens;
+
+            std::chrono::microseconds openTime;
+            std::chrono::microseconds maxOpenTime;
+
+            /**
+             * Writes the counters, and the total and longest open times in
+             * milliseconds.
+             *
+             * \param stream The stream to write the report to.
+             */
+            void report(std::ostream & stream) const;
+        };
+
+        /**
+         * A handle checked out of the pool, returned when it is destroyed.
+         */
+        class Handle
+        {
+            public:
+                Handle(Handle && other);
+                ~Handle();
+
+                notmuch_database_t * get() const;
+
+                /**
+                 * Reopens the database, for example after an operation failed
+                 * because it was modified by another program.
+                 */
+                void reopen();
+
+            private:
+                Handle(DatabasePool & pool, notmuch_database_t * database, unsigned generation);
+
+                Handle(const Handle &) = delete;
+                Handle & operator=(const Handle &) = delete;
+
+                DatabasePool * _pool;
+                notmuch_database_t * _database;
+                unsigned _generation;
+
+            friend class DatabasePool;
+        };
+
+        static DatabasePool & instance()
+        {
+            return *_instance;
+        }
+
+        DatabasePool();
+
+        /**
+         * Closes the idle handles. All handles must have been returned.
+         */
+        ~DatabasePool();
+
+        /**
+         * Checks out a handle, waiting for one if all of them are in use.
+         */
+        Handle acquire();
+
+        /**
+         * Checks out a handle without waiting for other threads to return
+         * one, for use from the UI thread.
+         *
+         * \return The handle, or NULL if all of them are in use.
+         */
+        std::unique_ptr<Handle> tryAcquire();
+
+        /**
+         * Marks the open handles as out of date.
+         *
+         * This may be called from any thread.
+         */
+        void invalidate();
+
+        Statistics statistics() const;
+
+    private:
+        static DatabasePool * _instance;
+
+        struct IdleHandle
+        {
+            notmuch_database_t * database;
+            unsigned generation;
+        };
+
+        /**
+         * Checks out an idle handle, or opens a new one. There must be one
+         * idle, or fewer than the most handles open.
+         *
+         * \param lock The lock on _mutex, which is released while opening.
+         */
+        Handle checkOut(std::unique_lock<std::mutex> & lock);
+
+        notmuch_database_t * open();
+        void release(notmuch_database_t * database, unsigned generation);
+
+        mutable std::mutex _mutex;
+        std::condition_variable _condition;
+
+        std::vector<IdleHandle> _idle;
+        unsigned _open;
+
+        /* Incremented whenever the database changes */
+        unsigned _generation;
+
+        Statistics _statistics;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
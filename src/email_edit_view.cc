@@ -204,13 +204,17 @@ void EmailEditView::attach()
     _parts.push_back(std::make_shared<Attachment>(data, g_file_get_basename(file),
                                                   g_file_info_get_content_type(fileinfo),
                                                   g_mime_stream_length(filestream)));
+    invalidate();
 }
 
 void EmailEditView::removeSelectedAttachment()
 {
     PartList::iterator selection = selectedPart();
     if (dynamic_cast<Attachment*>(selection->get()))
+    {
         _parts.erase(selection);
+        invalidate();
+    }
 }
 
 void EmailEditView::setIdentity(const std::string & name)
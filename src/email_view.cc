@@ -25,6 +25,7 @@
 #include "status_bar.hh"
 #include "message_part_display_visitor.hh"
 #include "message_part_save_visitor.hh"
+#include "message_cache.hh"
 
 const std::string lessMessage("[less]");
 const std::string moreMessage("[more]");
@@ -48,80 +49,105 @@ EmailView::~EmailView()
 void EmailView::setEmail(const std::string & filename)
 {
     _parts.clear();
+    _filename = filename;
 
-    FILE * file = fopen(filename.c_str(), "r");
+    std::shared_ptr<const ParsedMessage> message = MessageCache::instance().message(filename);
 
-    if (file != NULL)
+    if (message)
     {
-        GMimeStream * stream = g_mime_stream_file_new(file);
-        GMimeParser * parser = g_mime_parser_new_with_stream(stream);
-        GMimeMessage * message = g_mime_parser_construct_message(parser);
-
-        /* Read relavant headers */
-        _headers = {
-            { "To",         internet_address_list_to_string(g_mime_message_get_recipients(message,
-                GMIME_RECIPIENT_TYPE_TO), true) ? : "(null)" },
-            { "From",       g_mime_message_get_sender(message) ? : "(null)" },
-            { "Cc",         internet_address_list_to_string(g_mime_message_get_recipients(message,
-                GMIME_RECIPIENT_TYPE_CC), true) ? : "(null)" },
-            { "Bcc",         internet_address_list_to_string(g_mime_message_get_recipients(message,
-                GMIME_RECIPIENT_TYPE_BCC), true) ? : "(null)" },
-            { "Subject",    g_mime_message_get_subject(message) ? : "(null)" }
-        };
-
-        GMimeObject * mimePart = g_mime_message_get_mime_part(message);
-
-        /* Locate plain text parts */
-        processMimePart(mimePart, std::back_inserter(_parts));
-        if (not _parts.empty())
-            _parts[0]->folded = false;
-
-        g_object_unref(mimePart);
+        _headers = message->headers;
+        _parts = message->parts;
     }
+
+    /* Only the first part starts unfolded */
+    _folded.assign(_parts.size(), true);
+
+    if (!_folded.empty())
+        _folded.front() = false;
+
+    invalidate();
 }
 
 void EmailView::setVisibleHeaders(const std::vector<std::string> & headers)
 {
     _visibleHeaders = headers;
+    invalidate();
 }
 
 void EmailView::update()
 {
-    int row = 0;
+    int top = _visibleHeaders.size() + 1;
+    int height = visibleLines();
 
-    _partsEndLine.clear();
-    werase(_window);
+    /* Show parts converted in the background */
+    bool converted = false;
+
+    for (auto part = _parts.begin(), e = _parts.end(); part != e; ++part)
+    {
+        if ((*part)->update())
+            converted = true;
+    }
 
-    for (auto header = _visibleHeaders.begin(), e = _visibleHeaders.end(); header != e; ++header, ++row)
+    if (converted)
     {
-        int x = 0;
+        MessageCache::instance().remeasure(_filename);
+        invalidate();
+    }
 
-        wmove(_window, row, x);
+    /* The more and less indicators are drawn over the first and last lines */
+    invalidateLine(_drawnOffset);
+    invalidateLine(_drawnOffset + height - 1);
+    invalidateLine(_offset);
+    invalidateLine(_offset + height - 1);
+
+    std::vector<int> lines;
+    bool all = prepareUpdate(top, lines);
+
+    if (all)
+    {
+        int row = 0;
 
-        try
+        werase(_window);
+
+        for (auto header = _visibleHeaders.begin(), e = _visibleHeaders.end(); header != e; ++header, ++row)
         {
-            x += NCurses::addPlainString(_window, (*header) + ": ",
-                0, ColorID::EmailViewHeader);
+            int x = 0;
+
+            wmove(_window, row, x);
+
+            try
+            {
+                x += NCurses::addPlainString(_window, (*header) + ": ",
+                    0, ColorID::EmailViewHeader);
 
-            NCurses::checkMove(_window, x);
+                NCurses::checkMove(_window, x);
 
-            x += NCurses::addUtf8String(_window, _headers[*header].c_str());
+                x += NCurses::addUtf8String(_window, _headers[*header].c_str());
 
-            NCurses::checkMove(_window, x - 1);
+                NCurses::checkMove(_window, x - 1);
+            }
+            catch (const NCurses::CutOffException & e)
+            {
+                NCurses::addCutOffIndicator(_window);
+            }
         }
-        catch (const NCurses::CutOffException & e)
+
+        wmove(_window, row, 0);
+        whline(_window, 0, _geometry.width);
+    }
+    else
+    {
+        for (auto index = lines.begin(), e = lines.end(); index != e; ++index)
         {
-            NCurses::addCutOffIndicator(_window);
+            wmove(_window, top + *index - _offset, 0);
+            wclrtoeol(_window);
         }
     }
 
-    wmove(_window, row, 0);
-    whline(_window, 0, _geometry.width);
-    ++row;
-
-    MessagePartDisplayVisitor displayVisitor(_window, View::Geometry{ 0, row,
-        _geometry.width, visibleLines() }, _offset, _selectedIndex, _parts.size() > 1);
+    _partsEndLine.clear();
 
+    MessagePartDisplayVisitor displayVisitor(_window, View::Geometry{ 0, top,
+        _geometry.width, height }, _offset, _selectedIndex, lines, _folded, _parts.size() > 1);
 
     for (auto part = _parts.begin(), e = _parts.end(); part != e; ++part)
     {
@@ -129,18 +155,20 @@ void EmailView::update()
         _partsEndLine.push_back(displayVisitor.lines());
     }
 
-    row = displayVisitor.row();
     _lineCount = displayVisitor.lines();
 
-    for (; row < getmaxy(_window); ++row)
-        mvwaddch(_window, row, 0, '~' | A_BOLD | COLOR_PAIR(ColorID::EmptySpaceIndicator));
+    for (auto index = lines.begin(), e = lines.end(); index != e; ++index)
+    {
+        if (*index >= _lineCount)
+            mvwaddch(_window, top + *index - _offset, 0, '~' | A_BOLD | COLOR_PAIR(ColorID::EmptySpaceIndicator));
+    }
 
     wattron(_window, COLOR_PAIR(ColorID::MoreLessIndicator));
 
     if (_offset > 0)
-        mvwaddstr(_window, _visibleHeaders.size() + 1, _geometry.width - lessMessage.size(), lessMessage.c_str());
+        mvwaddstr(_window, top, _geometry.width - lessMessage.size(), lessMessage.c_str());
 
-    if (_offset + visibleLines() < _lineCount)
+    if (_offset + height < _lineCount)
         mvwaddstr(_window, getmaxy(_window) - 1, _geometry.width - moreMessage.size(), moreMessage.c_str());
 
     wattroff(_window, COLOR_PAIR(ColorID::MoreLessIndicator));
@@ -168,7 +196,9 @@ void EmailView::toggleSelectedPartFolding()
     if (_parts.size() == 1)
         return;
 
-    (*part)->folded = not (*part)->folded;
+    int index = std::distance(_parts.begin(), part);
+    _folded[index] = !_folded[index];
+    invalidate();
 
     if (part != _parts.begin())
         _selectedIndex = _partsEndLine[std::distance(_parts.begin(), part) - 1];
@@ -54,8 +54,15 @@ class EmailView : public LineBrowserView
         std::map<std::string, std::string> _headers;
         std::vector<std::string> _visibleHeaders;
 
+        /* The message file shown, whose cache entry holds the parts */
+        std::string _filename;
+
         PartList _parts;
         std::vector<int> _partsEndLine;
+
+        /* Whether each part is folded, in this view only, since the parts
+         * are shared with other views of the same message */
+        std::vector<bool> _folded;
 };
 
 #endif
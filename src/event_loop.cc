@@ -0,0 +1,279 @@
+/* ner: src/event_loop.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <poll.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "event_loop.hh"
+#include "ncurses.hh"
+
+EventLoop * EventLoop::_instance = 0;
+int EventLoop::_signalDescriptor = -1;
+volatile std::sig_atomic_t EventLoop::_resized = 0;
+
+EventLoop::EventLoop()
+    : _idleTimeout(-1), _woken(false), _nextTimer(1)
+{
+    _instance = this;
+
+    _eventDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    _timerDescriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (_eventDescriptor == -1 || _timerDescriptor == -1)
+        throw std::runtime_error(std::string("Could not create event loop: ") + std::strerror(errno));
+
+    _signalDescriptor = _eventDescriptor;
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = &EventLoop::handleResize;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGWINCH, &action, NULL);
+}
+
+EventLoop::~EventLoop()
+{
+    std::signal(SIGWINCH, SIG_DFL);
+    _signalDescriptor = -1;
+
+    close(_eventDescriptor);
+    close(_timerDescriptor);
+
+    _instance = 0;
+}
+
+int EventLoop::readKey()
+{
+    _woken = false;
+
+    while (true)
+    {
+        /* Keys which are already waiting come first */
+        int key = getch();
+
+        if (key != ERR)
+        {
+            resetIdleDeadline();
+            return key;
+        }
+
+        int timeout = -1;
+
+        if (_idleTimeout >= 0)
+        {
+            timeout = std::max<int>(0, std::chrono::duration_cast<std::chrono::milliseconds>(
+                _idleDeadline - std::chrono::steady_clock::now()).count());
+        }
+
+        switch (wait(timeout, true))
+        {
+            case Result::Input:
+                break;
+            case Result::Events:
+                _woken = true;
+                return ERR;
+            case Result::Timeout:
+                resetIdleDeadline();
+                return ERR;
+        }
+    }
+}
+
+bool EventLoop::woken() const
+{
+    return _woken;
+}
+
+void EventLoop::setIdleTimeout(int timeout)
+{
+    _idleTimeout = timeout;
+    resetIdleDeadline();
+}
+
+void EventLoop::resetIdleDeadline()
+{
+    _idleDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_idleTimeout);
+}
+
+void EventLoop::dispatch()
+{
+    wait(0, false);
+}
+
+void EventLoop::post(const std::function<void ()> & callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(_postedMutex);
+        _posted.push_back(callback);
+    }
+
+    wake();
+}
+
+void EventLoop::wake()
+{
+    uint64_t count = 1;
+
+    /* This only fails if the counter is about to overflow, in which case
+     * the loop has plenty of wake ups pending anyway */
+    while (write(_eventDescriptor, &count, sizeof(count)) == -1 && errno == EINTR)
+        ;
+}
+
+EventLoop::Timer EventLoop::addTimer(std::chrono::milliseconds delay,
+    const std::function<void ()> & callback)
+{
+    Timer timer = _nextTimer++;
+
+    _timers.insert(TimerMap::value_type(std::chrono::steady_clock::now() + delay,
+        PendingTimer{ timer, callback }));
+    armTimer();
+
+    return timer;
+}
+
+void EventLoop::cancelTimer(Timer timer)
+{
+    for (auto pending = _timers.begin(), e = _timers.end(); pending != e; ++pending)
+    {
+        if (pending->second.id == timer)
+        {
+            _timers.erase(pending);
+            armTimer();
+            break;
+        }
+    }
+}
+
+void EventLoop::setResizeHandler(const std::function<void ()> & handler)
+{
+    _resizeHandler = handler;
+}
+
+EventLoop::Result EventLoop::wait(int timeout, bool input)
+{
+    struct pollfd descriptors[] = {
+        { _eventDescriptor, POLLIN, 0 },
+        { _timerDescriptor, POLLIN, 0 },
+        { STDIN_FILENO, POLLIN, 0 }
+    };
+
+    int ready;
+
+    do
+        ready = poll(descriptors, input ? 3 : 2, timeout);
+    while (ready == -1 && errno == EINTR && _resized == 0);
+
+    if (ready <= 0 && _resized == 0)
+        return Result::Timeout;
+
+    uint64_t count;
+
+    if (descriptors[0].revents & POLLIN)
+        read(_eventDescriptor, &count, sizeof(count));
+
+    if (descriptors[1].revents & POLLIN)
+        read(_timerDescriptor, &count, sizeof(count));
+
+    runEvents();
+
+    if (input && descriptors[2].revents)
+        return Result::Input;
+
+    return Result::Events;
+}
+
+void EventLoop::runEvents()
+{
+    if (_resized)
+    {
+        _resized = 0;
+
+        if (_resizeHandler)
+            _resizeHandler();
+    }
+
+    std::vector<std::function<void ()>> posted;
+
+    {
+        std::lock_guard<std::mutex> lock(_postedMutex);
+        posted.swap(_posted);
+    }
+
+    for (auto callback = posted.begin(), e = posted.end(); callback != e; ++callback)
+        (*callback)();
+
+    auto now = std::chrono::steady_clock::now();
+
+    /* Timers may add or cancel other timers, so take them out first */
+    while (!_timers.empty() && _timers.begin()->first <= now)
+    {
+        std::function<void ()> callback(std::move(_timers.begin()->second.callback));
+        _timers.erase(_timers.begin());
+        callback();
+    }
+
+    armTimer();
+}
+
+void EventLoop::armTimer()
+{
+    struct itimerspec value;
+    std::memset(&value, 0, sizeof(value));
+
+    if (!_timers.empty())
+    {
+        auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            _timers.begin()->first - std::chrono::steady_clock::now()).count();
+
+        /* A zero value would disarm the timer instead */
+        delay = std::max<decltype(delay)>(delay, 1);
+
+        value.it_value.tv_sec = delay / 1000000000;
+        value.it_value.tv_nsec = delay % 1000000000;
+    }
+
+    timerfd_settime(_timerDescriptor, 0, &value, NULL);
+}
+
+void EventLoop::handleResize(int)
+{
+    int savedErrno = errno;
+
+    _resized = 1;
+
+    if (_signalDescriptor != -1)
+    {
+        uint64_t count = 1;
+        write(_signalDescriptor, &count, sizeof(count));
+    }
+
+    errno = savedErrno;
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
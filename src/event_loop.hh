@@ -0,0 +1,167 @@
+/* ner: src/event_loop.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_EVENT_LOOP_H
+#define NER_EVENT_LOOP_H 1
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <csignal>
+
+/**
+ * Waits for keys, and runs everything else which happens meanwhile.
+ *
+ * Besides the terminal, the loop watches an eventfd, through which other
+ * threads wake it up or hand it work, and a timerfd, armed for the earliest
+ * pending timer. Terminal resizes are noted by the SIGWINCH handler and
+ * handled by the loop, outside of signal context.
+ */
+class EventLoop
+{
+    public:
+        typedef unsigned Timer;
+
+        static EventLoop & instance()
+        {
+            return *_instance;
+        }
+
+        EventLoop();
+        ~EventLoop();
+
+        /**
+         * Reads the next key from the terminal, running other events while
+         * waiting for it.
+         *
+         * \return The key, or ERR if the idle timeout passed or other events
+         *         were run, as told by woken().
+         */
+        int readKey();
+
+        /**
+         * Returns whether the last ERR from readKey was because other events
+         * were run, rather than because of the idle timeout.
+         */
+        bool woken() const;
+
+        /**
+         * Sets how long readKey waits for a key before returning ERR.
+         *
+         * \param timeout The timeout in milliseconds, or -1 to wait forever.
+         */
+        void setIdleTimeout(int timeout);
+
+        /**
+         * Runs the events which are ready, without waiting.
+         */
+        void dispatch();
+
+        /**
+         * Runs a function on the thread running the loop.
+         *
+         * This may be called from any thread.
+         */
+        void post(const std::function<void ()> & callback);
+
+        /**
+         * Wakes up readKey, so the screen gets updated.
+         *
+         * This may be called from any thread.
+         */
+        void wake();
+
+        /**
+         * Runs a function once the given delay has passed.
+         *
+         * \return The timer, to be used with cancelTimer.
+         */
+        Timer addTimer(std::chrono::milliseconds delay, const std::function<void ()> & callback);
+
+        /**
+         * Cancels a timer, if it has not run yet.
+         */
+        void cancelTimer(Timer timer);
+
+        /**
+         * Sets the function run when the terminal is resized.
+         */
+        void setResizeHandler(const std::function<void ()> & handler);
+
+    private:
+        enum class Result
+        {
+            Input,
+            Events,
+            Timeout
+        };
+
+        struct PendingTimer
+        {
+            Timer id;
+            std::function<void ()> callback;
+        };
+
+        typedef std::multimap<std::chrono::steady_clock::time_point, PendingTimer> TimerMap;
+
+        /**
+         * Waits until there is input or events were run.
+         *
+         * \param timeout The longest time to wait in milliseconds, or -1.
+         * \param input Whether to wait for input from the terminal.
+         */
+        Result wait(int timeout, bool input);
+
+        void runEvents();
+        void resetIdleDeadline();
+        void armTimer();
+
+        static void handleResize(int signal);
+
+        static EventLoop * _instance;
+
+        /* Shared with the signal handler */
+        static int _signalDescriptor;
+        static volatile std::sig_atomic_t _resized;
+
+        int _eventDescriptor;
+        int _timerDescriptor;
+
+        int _idleTimeout;
+        bool _woken;
+
+        /* When readKey times out, unless a key is read first. Waking the loop
+         * doesn't postpone it. */
+        std::chrono::steady_clock::time_point _idleDeadline;
+
+        std::mutex _postedMutex;
+        std::vector<std::function<void ()>> _posted;
+
+        Timer _nextTimer;
+        TimerMap _timers;
+
+        std::function<void ()> _resizeHandler;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
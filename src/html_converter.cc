@@ -0,0 +1,381 @@
+/* ner: src/html_converter.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+#include "html_converter.hh"
+#include "ner_config.hh"
+
+const std::string failedMessage("[HTML conversion failed]");
+
+HtmlConverter & HtmlConverter::instance()
+{
+    static HtmlConverter converter;
+
+    return converter;
+}
+
+HtmlConverter::HtmlConverter()
+    : _workerCount(0), _idleThreads(0), _stopping(false)
+{
+    /* A converter exiting early must not take us down with it */
+    std::signal(SIGPIPE, SIG_IGN);
+}
+
+HtmlConverter::~HtmlConverter()
+{
+    stop();
+
+    for (auto worker = _idleWorkers.begin(), e = _idleWorkers.end(); worker != e; ++worker)
+        terminate(*worker);
+}
+
+std::string HtmlConverter::convert(const std::string & html)
+{
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(NerConfig::instance().htmlTimeout());
+
+    if (NerConfig::instance().command("html_server").empty())
+        return convertWithCommand(html, deadline);
+    else
+        return convertWithServer(html, deadline);
+}
+
+void HtmlConverter::convertInBackground(const std::string & html,
+    const std::function<void (const std::string &)> & done)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_stopping)
+            return;
+
+        _jobs.push_back(Job{ html, done });
+
+        if (_idleThreads == 0 && _threads.size() < NerConfig::instance().htmlWorkers())
+        {
+            ++_idleThreads;
+            _threads.push_back(std::thread(std::bind(&HtmlConverter::run, this)));
+        }
+    }
+
+    _jobAvailable.notify_one();
+}
+
+void HtmlConverter::stop()
+{
+    std::vector<std::thread> threads;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _stopping = true;
+        _jobs.clear();
+        threads.swap(_threads);
+    }
+
+    _jobAvailable.notify_all();
+
+    for (auto thread = threads.begin(), e = threads.end(); thread != e; ++thread)
+        thread->join();
+}
+
+void HtmlConverter::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _jobAvailable.wait(lock, [this] { return !_jobs.empty() || _stopping; });
+
+        if (_stopping)
+            break;
+
+        Job job = _jobs.front();
+        _jobs.pop_front();
+        --_idleThreads;
+
+        lock.unlock();
+
+        std::string text = convert(job.html);
+
+        lock.lock();
+
+        if (!_stopping)
+        {
+            lock.unlock();
+            job.done(text);
+            lock.lock();
+        }
+
+        ++_idleThreads;
+    }
+}
+
+std::string HtmlConverter::convertWithServer(const std::string & html,
+    std::chrono::steady_clock::time_point deadline)
+{
+    Worker worker;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _workerAvailable.wait(lock, [this] {
+            return !_idleWorkers.empty() || _workerCount < NerConfig::instance().htmlWorkers();
+        });
+
+        if (!_idleWorkers.empty())
+        {
+            worker = _idleWorkers.back();
+            _idleWorkers.pop_back();
+        }
+        else
+        {
+            if (!spawn(NerConfig::instance().command("html_server"), worker))
+                return failedMessage;
+
+            ++_workerCount;
+        }
+    }
+
+    std::string response;
+    bool completed = exchange(worker, std::to_string(html.size()) + '\n' + html, response, true, deadline);
+
+    /* Take exactly the announced length, or whatever arrived before the
+     * deadline */
+    std::string text;
+    size_t headerEnd = response.find('\n');
+
+    if (headerEnd != std::string::npos)
+        text = response.substr(headerEnd + 1, std::strtoul(response.c_str(), NULL, 10));
+
+    if (!completed)
+    {
+        terminate(worker);
+        text += '\n' + failedMessage;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (completed)
+            _idleWorkers.push_back(worker);
+        else
+            --_workerCount;
+    }
+
+    _workerAvailable.notify_one();
+
+    return text;
+}
+
+std::string HtmlConverter::convertWithCommand(const std::string & html,
+    std::chrono::steady_clock::time_point deadline)
+{
+    Worker worker;
+
+    if (!spawn(NerConfig::instance().command("html"), worker))
+        return failedMessage;
+
+    std::string text;
+    bool completed = exchange(worker, html, text, false, deadline);
+
+    terminate(worker);
+
+    if (!completed)
+        text += '\n' + failedMessage;
+
+    return text;
+}
+
+bool HtmlConverter::spawn(const std::string & command, Worker & worker)
+{
+    int inputPipe[2];
+    int outputPipe[2];
+
+    /* Close-on-exec from the start, so that converters started by other
+     * threads cannot hold our pipes open */
+    if (pipe2(inputPipe, O_CLOEXEC) != 0)
+        return false;
+
+    if (pipe2(outputPipe, O_CLOEXEC) != 0)
+    {
+        close(inputPipe[0]);
+        close(inputPipe[1]);
+        return false;
+    }
+
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        dup2(inputPipe[0], 0);
+        dup2(outputPipe[1], 1);
+
+        close(inputPipe[0]);
+        close(inputPipe[1]);
+        close(outputPipe[0]);
+        close(outputPipe[1]);
+
+        execlp("sh", "sh", "-c", command.c_str(), NULL);
+        _exit(127);
+    }
+
+    close(inputPipe[0]);
+    close(outputPipe[1]);
+
+    if (pid < 0)
+    {
+        close(inputPipe[1]);
+        close(outputPipe[0]);
+        return false;
+    }
+
+    worker.pid = pid;
+    worker.input = inputPipe[1];
+    worker.output = outputPipe[0];
+
+    fcntl(worker.input, F_SETFL, fcntl(worker.input, F_GETFL) | O_NONBLOCK);
+    fcntl(worker.output, F_SETFL, fcntl(worker.output, F_GETFL) | O_NONBLOCK);
+
+    return true;
+}
+
+void HtmlConverter::terminate(Worker & worker)
+{
+    if (worker.input >= 0)
+        close(worker.input);
+
+    close(worker.output);
+
+    /* Give it a short while to exit on its own, so that a converter ignoring
+     * SIGTERM cannot hang the caller */
+    const auto gracePeriod = std::chrono::milliseconds(50);
+    const auto pollInterval = std::chrono::milliseconds(5);
+
+    int status;
+
+    if (waitpid(worker.pid, &status, WNOHANG) != 0)
+        return;
+
+    kill(worker.pid, SIGTERM);
+
+    auto deadline = std::chrono::steady_clock::now() + gracePeriod;
+
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(pollInterval);
+
+        if (waitpid(worker.pid, &status, WNOHANG) != 0)
+            return;
+    }
+
+    kill(worker.pid, SIGKILL);
+    waitpid(worker.pid, &status, 0);
+}
+
+bool HtmlConverter::exchange(Worker & worker, const std::string & input, std::string & output,
+    bool framed, std::chrono::steady_clock::time_point deadline)
+{
+    size_t written = 0;
+
+    if (input.empty() && !framed)
+    {
+        close(worker.input);
+        worker.input = -1;
+    }
+
+    while (true)
+    {
+        if (framed)
+        {
+            size_t headerEnd = output.find('\n');
+
+            if (headerEnd != std::string::npos &&
+                output.size() - headerEnd - 1 >= std::strtoul(output.c_str(), NULL, 10))
+            {
+                return true;
+            }
+        }
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+
+        if (remaining.count() <= 0)
+            return false;
+
+        struct pollfd descriptors[2] = {
+            { worker.output, POLLIN, 0 },
+            { worker.input, POLLOUT, 0 }
+        };
+
+        bool writing = written < input.size() && worker.input >= 0;
+
+        if (poll(descriptors, writing ? 2 : 1, remaining.count()) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        if (writing && descriptors[1].revents)
+        {
+            ssize_t count = write(worker.input, input.data() + written, input.size() - written);
+
+            if (count < 0 && errno != EAGAIN && errno != EINTR)
+                return false;
+
+            if (count > 0)
+                written += count;
+
+            /* One-shot converters need to see the end of their input */
+            if (written == input.size() && !framed)
+            {
+                close(worker.input);
+                worker.input = -1;
+            }
+        }
+
+        if (descriptors[0].revents)
+        {
+            char buffer[4096];
+            ssize_t count = read(worker.output, buffer, sizeof(buffer));
+
+            if (count > 0)
+                output.append(buffer, count);
+            else if (count == 0)
+                /* The end of the output is only expected from one-shot converters */
+                return !framed;
+            else if (errno != EAGAIN && errno != EINTR)
+                return false;
+        }
+    }
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
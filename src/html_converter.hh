@@ -0,0 +1,142 @@
+/* ner: src/html_converter.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_HTML_CONVERTER_H
+#define NER_HTML_CONVERTER_H 1
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <sys/types.h>
+
+/**
+ * Converts HTML parts to plain text with an external command.
+ *
+ * If the html_server command is configured, a pool of long-lived converters
+ * is kept running, and each conversion is a framed request to one of them:
+ * the length of the data in bytes as a decimal number followed by a newline,
+ * and then the data itself. The converter replies with the text in the same
+ * format. Otherwise, the html command is run once for each conversion.
+ *
+ * Input and output are multiplexed with poll, so a converter which writes
+ * before reading all of its input cannot deadlock, and conversions taking
+ * longer than html_timeout are abandoned.
+ *
+ * Conversions can also be run in the background, on up to html_workers
+ * threads of the converter's own.
+ *
+ * This class is a singleton, and may be used from any thread.
+ */
+class HtmlConverter
+{
+    public:
+        static HtmlConverter & instance();
+
+        /**
+         * Converts the HTML to plain text.
+         *
+         * \param html The HTML to convert.
+         * \return The text. If the conversion failed or timed out, this is
+         *         whatever was produced followed by a note saying so.
+         */
+        std::string convert(const std::string & html);
+
+        /**
+         * Converts the HTML to plain text on a background thread.
+         *
+         * \param html The HTML to convert.
+         * \param done Called with the text, as returned by convert, on the
+         *             background thread. It is not called once stop has been
+         *             called.
+         */
+        void convertInBackground(const std::string & html,
+            const std::function<void (const std::string &)> & done);
+
+        /**
+         * Drops the queued background conversions, and waits for the running
+         * ones to finish.
+         */
+        void stop();
+
+    private:
+        struct Worker
+        {
+            pid_t pid;
+
+            /* Our ends of the converter's standard input and output */
+            int input;
+            int output;
+        };
+
+        struct Job
+        {
+            std::string html;
+            std::function<void (const std::string &)> done;
+        };
+
+        HtmlConverter();
+        ~HtmlConverter();
+
+        /**
+         * Runs background conversions until stopped.
+         */
+        void run();
+
+        static bool spawn(const std::string & command, Worker & worker);
+        static void terminate(Worker & worker);
+
+        /**
+         * Writes the input to the worker while reading its output.
+         *
+         * \param worker The worker to talk to.
+         * \param input The data to write.
+         * \param output The data read is appended here.
+         * \param framed Whether to stop after one framed reply, rather than at
+         *               the end of the output.
+         * \param deadline When to give up.
+         * \return Whether the exchange completed.
+         */
+        static bool exchange(Worker & worker, const std::string & input, std::string & output,
+            bool framed, std::chrono::steady_clock::time_point deadline);
+
+        std::string convertWithServer(const std::string & html, std::chrono::steady_clock::time_point deadline);
+        std::string convertWithCommand(const std::string & html, std::chrono::steady_clock::time_point deadline);
+
+        std::mutex _mutex;
+        std::condition_variable _workerAvailable;
+
+        std::vector<Worker> _idleWorkers;
+        unsigned _workerCount;
+
+        std::condition_variable _jobAvailable;
+        std::deque<Job> _jobs;
+        std::vector<std::thread> _threads;
+        unsigned _idleThreads;
+        bool _stopping;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
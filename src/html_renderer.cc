@@ -0,0 +1,675 @@
+/* ner: src/html_renderer.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <algorithm>
+
+#include "html_renderer.hh"
+
+namespace
+{
+    const std::map<std::string, unsigned> namedEntities = {
+        { "amp",    '&' },      { "lt",     '<' },      { "gt",     '>' },
+        { "quot",   '"' },      { "apos",   '\'' },     { "nbsp",   ' ' },
+        { "copy",   0xa9 },     { "reg",    0xae },     { "trade",  0x2122 },
+        { "deg",    0xb0 },     { "plusmn", 0xb1 },     { "times",  0xd7 },
+        { "divide", 0xf7 },     { "middot", 0xb7 },     { "bull",   0x2022 },
+        { "hellip", 0x2026 },   { "ndash",  0x2013 },   { "mdash",  0x2014 },
+        { "lsquo",  0x2018 },   { "rsquo",  0x2019 },   { "ldquo",  0x201c },
+        { "rdquo",  0x201d },   { "laquo",  0xab },     { "raquo",  0xbb },
+        { "euro",   0x20ac },   { "pound",  0xa3 },     { "yen",    0xa5 },
+        { "cent",   0xa2 },     { "sect",   0xa7 },     { "para",   0xb6 },
+        { "zwnj",   0x200c },   { "zwj",    0x200d },   { "shy",    0xad }
+    };
+
+    /* Elements ending the current line */
+    const char * lineElements[] = {
+        "div", "tr", "dt", "dd", "section", "article", "header", "footer",
+        "center", "form", "address", "caption", "nav", "aside", "main"
+    };
+
+    /* Elements set apart by blank lines */
+    const char * blockElements[] = {
+        "p", "h1", "h2", "h3", "h4", "h5", "h6", "table", "dl", "figure"
+    };
+
+    /* Elements whose content is not shown */
+    const char * skippedElements[] = {
+        "script", "style", "title", "head", "template", "noscript"
+    };
+
+    template <size_t size>
+        bool contains(const char * (&names)[size], const std::string & name)
+    {
+        return std::find_if(names, names + size, [&name](const char * element) {
+            return name == element;
+        }) != names + size;
+    }
+
+    void appendUtf8(std::string & string, unsigned codePoint)
+    {
+        if (codePoint < 0x80)
+            string.push_back(codePoint);
+        else if (codePoint < 0x800)
+        {
+            string.push_back(0xc0 | (codePoint >> 6));
+            string.push_back(0x80 | (codePoint & 0x3f));
+        }
+        else if (codePoint < 0x10000)
+        {
+            string.push_back(0xe0 | (codePoint >> 12));
+            string.push_back(0x80 | ((codePoint >> 6) & 0x3f));
+            string.push_back(0x80 | (codePoint & 0x3f));
+        }
+        else if (codePoint < 0x110000)
+        {
+            string.push_back(0xf0 | (codePoint >> 18));
+            string.push_back(0x80 | ((codePoint >> 12) & 0x3f));
+            string.push_back(0x80 | ((codePoint >> 6) & 0x3f));
+            string.push_back(0x80 | (codePoint & 0x3f));
+        }
+    }
+
+    /**
+     * Finds the '>' ending a tag, skipping those inside quoted attribute
+     * values.
+     *
+     * \return The position of the '>', or npos if the tag is incomplete.
+     */
+    size_t findTagEnd(const std::string & html, size_t position)
+    {
+        char quote = 0;
+        char previous = 0;
+
+        for (; position < html.size(); ++position)
+        {
+            char character = html[position];
+
+            if (quote)
+            {
+                if (character == quote)
+                    quote = 0;
+            }
+            /* Quotes only start a value straight after the '=' */
+            else if ((character == '"' || character == '\'') && previous == '=')
+                quote = character;
+            else if (character == '>')
+                return position;
+
+            if (!std::isspace(static_cast<unsigned char>(character)))
+                previous = character;
+        }
+
+        return std::string::npos;
+    }
+}
+
+HtmlRenderer::HtmlRenderer()
+{
+    reset();
+}
+
+void HtmlRenderer::reset()
+{
+    _state = State::Text;
+    _pending.clear();
+    _output.clear();
+    _line.clear();
+    _lineStarted = false;
+    _pendingSpace = false;
+    _blankLine = true;
+    _skipping.clear();
+    _quoteDepth = 0;
+    _preDepth = 0;
+    _lists.clear();
+    _firstCell = true;
+    _link.clear();
+    _links.clear();
+}
+
+std::string HtmlRenderer::feed(const char * data, size_t length)
+{
+    _pending.append(data, length);
+
+    size_t position = 0;
+
+    while (position < _pending.size())
+    {
+        if (_state == State::Comment)
+        {
+            size_t end = _pending.find("-->", position);
+
+            if (end == std::string::npos)
+            {
+                /* Keep enough to find the end when the rest arrives */
+                if (_pending.size() >= 2)
+                    position = std::max(position, _pending.size() - 2);
+
+                break;
+            }
+
+            position = end + 3;
+            _state = State::Text;
+        }
+        else if (_state == State::Tag)
+        {
+            size_t end = findTagEnd(_pending, position);
+
+            if (end == std::string::npos)
+                break;
+
+            handleTag(_pending.substr(position, end - position));
+            position = end + 1;
+            _state = State::Text;
+        }
+        else
+        {
+            size_t tag = _pending.find('<', position);
+
+            if (tag == std::string::npos)
+            {
+                /* Hold back a trailing entity which may be incomplete */
+                size_t entity = _pending.rfind('&');
+
+                if (entity != std::string::npos && entity >= position &&
+                    _pending.size() - entity < 12 && _pending.find(';', entity) == std::string::npos)
+                {
+                    handleText(_pending.substr(position, entity - position));
+                    position = entity;
+                }
+                else
+                {
+                    handleText(_pending.substr(position));
+                    position = _pending.size();
+                }
+
+                break;
+            }
+
+            handleText(_pending.substr(position, tag - position));
+
+            /* Wait until we can tell whether this is a comment */
+            if (_pending.size() - tag < 4)
+            {
+                position = tag;
+                break;
+            }
+
+            if (_pending.compare(tag, 4, "<!--") == 0)
+            {
+                position = tag + 4;
+                _state = State::Comment;
+            }
+            else
+            {
+                position = tag + 1;
+                _state = State::Tag;
+            }
+        }
+    }
+
+    _pending.erase(0, position);
+
+    return takeOutput();
+}
+
+std::string HtmlRenderer::finish()
+{
+    /* Drop whatever is left of an unterminated tag */
+    if (_state == State::Text && (_pending.empty() || _pending[0] != '<'))
+        handleText(_pending);
+
+    _pending.clear();
+
+    endLine();
+
+    if (!_links.empty())
+    {
+        separateBlock();
+
+        for (size_t index = 0; index < _links.size(); ++index)
+            _output += "[" + std::to_string(index + 1) + "] " + _links[index] + '\n';
+    }
+
+    std::string output = takeOutput();
+
+    reset();
+
+    return output;
+}
+
+void HtmlRenderer::handleText(const std::string & text)
+{
+    if (!_skipping.empty() || text.empty())
+        return;
+
+    std::string decoded = decodeEntities(text);
+
+    if (_preDepth > 0)
+    {
+        for (auto character = decoded.begin(), e = decoded.end(); character != e; ++character)
+        {
+            if (*character == '\n')
+                breakLine();
+            else if (*character != '\r')
+            {
+                startLine();
+                _line.push_back(*character);
+            }
+        }
+
+        return;
+    }
+
+    for (auto character = decoded.begin(), e = decoded.end(); character != e; ++character)
+    {
+        if (std::isspace(static_cast<unsigned char>(*character)))
+            _pendingSpace = true;
+        else
+        {
+            if (_pendingSpace && _lineStarted && !_line.empty() && _line.back() != ' ')
+                _line.push_back(' ');
+
+            _pendingSpace = false;
+            startLine();
+            _line.push_back(*character);
+        }
+    }
+}
+
+void HtmlRenderer::handleTag(const std::string & tag)
+{
+    if (tag.empty() || tag[0] == '!' || tag[0] == '?')
+        return;
+
+    bool closing = tag[0] == '/';
+
+    std::string name;
+
+    for (auto character = tag.begin() + (closing ? 1 : 0), e = tag.end();
+        character != e && std::isalnum(static_cast<unsigned char>(*character)); ++character)
+    {
+        name.push_back(std::tolower(static_cast<unsigned char>(*character)));
+    }
+
+    /* Only the end of the skipped element matters while skipping */
+    if (!_skipping.empty())
+    {
+        if (closing && name == _skipping)
+            _skipping.clear();
+
+        return;
+    }
+
+    if (contains(skippedElements, name))
+    {
+        if (!closing && tag.back() != '/')
+            _skipping = name;
+    }
+    else if (name == "br")
+        breakLine();
+    else if (contains(blockElements, name))
+    {
+        separateBlock();
+
+        if (name == "table" && !closing)
+            _firstCell = true;
+    }
+    else if (contains(lineElements, name))
+    {
+        endLine();
+
+        if (name == "tr")
+            _firstCell = true;
+    }
+    else if (name == "td" || name == "th")
+    {
+        if (!closing)
+        {
+            if (!_firstCell)
+                append(" | ");
+
+            _firstCell = false;
+        }
+    }
+    else if (name == "blockquote")
+    {
+        separateBlock();
+        _quoteDepth = std::max(0, _quoteDepth + (closing ? -1 : 1));
+    }
+    else if (name == "pre")
+    {
+        endLine();
+        _preDepth = std::max(0, _preDepth + (closing ? -1 : 1));
+    }
+    else if (name == "ul" || name == "ol")
+    {
+        if (closing)
+        {
+            if (!_lists.empty())
+                _lists.pop_back();
+
+            if (_lists.empty())
+                separateBlock();
+            else
+                endLine();
+        }
+        else
+        {
+            endLine();
+
+            std::string start = attribute(tag, "start");
+            _lists.push_back(name == "ul" ? 0 : (start.empty() ? 1 : std::atoi(start.c_str())));
+        }
+    }
+    else if (name == "li")
+    {
+        endLine();
+
+        if (!closing)
+        {
+            std::string marker(2 * (_lists.empty() ? 0 : _lists.size() - 1), ' ');
+
+            if (!_lists.empty() && _lists.back() > 0)
+                marker += std::to_string(_lists.back()++) + ". ";
+            else
+                marker += "* ";
+
+            append(marker);
+        }
+    }
+    else if (name == "hr")
+    {
+        endLine();
+        append(std::string(40, '-'));
+        endLine();
+    }
+    else if (name == "a")
+    {
+        if (closing)
+        {
+            /* Number the link unless it only jumps within the message */
+            if (!_link.empty() && _link[0] != '#')
+            {
+                auto existing = std::find(_links.begin(), _links.end(), _link);
+
+                if (existing == _links.end())
+                    existing = _links.insert(_links.end(), _link);
+
+                append("[" + std::to_string(existing - _links.begin() + 1) + "]");
+            }
+
+            _link.clear();
+        }
+        else
+            _link = decodeEntities(attribute(tag, "href"));
+    }
+    else if (name == "img")
+    {
+        std::string alt = decodeEntities(attribute(tag, "alt"));
+
+        if (!alt.empty())
+            append("[" + alt + "]");
+    }
+}
+
+void HtmlRenderer::append(const std::string & text)
+{
+    if (_pendingSpace && _lineStarted && !_line.empty() && _line.back() != ' ')
+        _line.push_back(' ');
+
+    _pendingSpace = false;
+    startLine();
+    _line += text;
+}
+
+void HtmlRenderer::startLine()
+{
+    if (_lineStarted)
+        return;
+
+    if (_quoteDepth > 0)
+        _line = std::string(_quoteDepth, '>') + ' ';
+
+    _lineStarted = true;
+}
+
+void HtmlRenderer::endLine()
+{
+    if (!_lineStarted)
+        return;
+
+    _output += _line;
+    _output += '\n';
+
+    _line.clear();
+    _lineStarted = false;
+    _pendingSpace = false;
+    _blankLine = false;
+}
+
+void HtmlRenderer::breakLine()
+{
+    startLine();
+    endLine();
+}
+
+void HtmlRenderer::separateBlock()
+{
+    endLine();
+
+    if (!_blankLine)
+    {
+        _output += '\n';
+        _blankLine = true;
+    }
+}
+
+std::string HtmlRenderer::takeOutput()
+{
+    std::string output;
+    output.swap(_output);
+    return output;
+}
+
+std::string HtmlRenderer::decodeEntities(const std::string & text)
+{
+    std::string decoded;
+    decoded.reserve(text.size());
+
+    for (size_t position = 0; position < text.size(); ++position)
+    {
+        size_t end;
+
+        if (text[position] != '&' || (end = text.find(';', position)) == std::string::npos ||
+            end - position > 10)
+        {
+            decoded.push_back(text[position]);
+            continue;
+        }
+
+        std::string entity = text.substr(position + 1, end - position - 1);
+        unsigned codePoint = 0;
+
+        if (entity.size() > 1 && entity[0] == '#')
+        {
+            if (entity[1] == 'x' || entity[1] == 'X')
+                codePoint = std::strtoul(entity.c_str() + 2, NULL, 16);
+            else
+                codePoint = std::strtoul(entity.c_str() + 1, NULL, 10);
+        }
+        else
+        {
+            auto named = namedEntities.find(entity);
+
+            if (named != namedEntities.end())
+                codePoint = named->second;
+        }
+
+        if (codePoint == 0)
+        {
+            decoded.push_back(text[position]);
+            continue;
+        }
+
+        appendUtf8(decoded, codePoint);
+        position = end;
+    }
+
+    return decoded;
+}
+
+std::string HtmlRenderer::attribute(const std::string & tag, const std::string & name)
+{
+    std::string lowerTag(tag);
+    std::transform(lowerTag.begin(), lowerTag.end(), lowerTag.begin(), ::tolower);
+
+    size_t position = 0;
+
+    while ((position = lowerTag.find(name, position)) != std::string::npos)
+    {
+        size_t end = position + name.size();
+
+        /* Make sure this is the whole attribute name */
+        if (position > 0 && !std::isspace(static_cast<unsigned char>(lowerTag[position - 1])))
+        {
+            position = end;
+            continue;
+        }
+
+        while (end < tag.size() && std::isspace(static_cast<unsigned char>(tag[end])))
+            ++end;
+
+        if (end >= tag.size() || tag[end] != '=')
+        {
+            position = end;
+            continue;
+        }
+
+        ++end;
+
+        while (end < tag.size() && std::isspace(static_cast<unsigned char>(tag[end])))
+            ++end;
+
+        if (end < tag.size() && (tag[end] == '"' || tag[end] == '\''))
+        {
+            size_t close = tag.find(tag[end], end + 1);
+            return tag.substr(end + 1, close == std::string::npos ? std::string::npos : close - end - 1);
+        }
+
+        size_t valueEnd = end;
+
+        while (valueEnd < tag.size() && !std::isspace(static_cast<unsigned char>(tag[valueEnd])))
+            ++valueEnd;
+
+        return tag.substr(end, valueEnd - end);
+    }
+
+    return std::string();
+}
+
+/* GMime filter wrapping the renderer */
+struct HtmlFilter
+{
+    GMimeFilter parent_object;
+    HtmlRenderer * renderer;
+};
+
+struct HtmlFilterClass
+{
+    GMimeFilterClass parent_class;
+};
+
+G_DEFINE_TYPE(HtmlFilter, html_filter, GMIME_TYPE_FILTER)
+
+static void html_filter_output(GMimeFilter * filter, const std::string & text,
+    char ** outbuf, size_t * outlen, size_t * outprespace)
+{
+    g_mime_filter_set_size(filter, text.size(), FALSE);
+    std::memcpy(filter->outbuf, text.data(), text.size());
+
+    *outbuf = filter->outbuf;
+    *outlen = text.size();
+    *outprespace = filter->outpre;
+}
+
+static GMimeFilter * html_filter_copy(GMimeFilter * filter)
+{
+    return HtmlRenderer::newFilter();
+}
+
+static void html_filter_filter(GMimeFilter * filter, char * inbuf, size_t inlen, size_t prespace,
+    char ** outbuf, size_t * outlen, size_t * outprespace)
+{
+    HtmlRenderer * renderer = reinterpret_cast<HtmlFilter *>(filter)->renderer;
+
+    html_filter_output(filter, renderer->feed(inbuf, inlen), outbuf, outlen, outprespace);
+}
+
+static void html_filter_complete(GMimeFilter * filter, char * inbuf, size_t inlen, size_t prespace,
+    char ** outbuf, size_t * outlen, size_t * outprespace)
+{
+    HtmlRenderer * renderer = reinterpret_cast<HtmlFilter *>(filter)->renderer;
+
+    std::string text = renderer->feed(inbuf, inlen);
+    text += renderer->finish();
+
+    html_filter_output(filter, text, outbuf, outlen, outprespace);
+}
+
+static void html_filter_reset(GMimeFilter * filter)
+{
+    reinterpret_cast<HtmlFilter *>(filter)->renderer->reset();
+}
+
+static void html_filter_finalize(GObject * object)
+{
+    delete reinterpret_cast<HtmlFilter *>(object)->renderer;
+
+    G_OBJECT_CLASS(html_filter_parent_class)->finalize(object);
+}
+
+static void html_filter_class_init(HtmlFilterClass * klass)
+{
+    GObjectClass * objectClass = G_OBJECT_CLASS(klass);
+    GMimeFilterClass * filterClass = GMIME_FILTER_CLASS(klass);
+
+    objectClass->finalize = html_filter_finalize;
+
+    filterClass->copy = html_filter_copy;
+    filterClass->filter = html_filter_filter;
+    filterClass->complete = html_filter_complete;
+    filterClass->reset = html_filter_reset;
+}
+
+static void html_filter_init(HtmlFilter * filter)
+{
+    filter->renderer = new HtmlRenderer();
+}
+
+GMimeFilter * HtmlRenderer::newFilter()
+{
+    return GMIME_FILTER(g_object_new(html_filter_get_type(), NULL));
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
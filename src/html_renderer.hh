@@ -0,0 +1,110 @@
+/* ner: src/html_renderer.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_HTML_RENDERER_H
+#define NER_HTML_RENDERER_H 1
+
+#include <string>
+#include <vector>
+#include <gmime/gmime.h>
+
+/**
+ * Renders HTML as plain text, as it arrives.
+ *
+ * Paragraphs, headings, line breaks, lists, block quotes, preformatted text
+ * and tables are laid out as lines; scripts and styles are dropped; entities
+ * are decoded; and links are numbered, with their targets listed at the end.
+ * Lines are not wrapped, since the views do that themselves.
+ */
+class HtmlRenderer
+{
+    public:
+        HtmlRenderer();
+
+        /**
+         * Renders the next piece of the document.
+         *
+         * \return The lines completed so far.
+         */
+        std::string feed(const char * data, size_t length);
+
+        /**
+         * Renders the rest of the document, followed by the list of links.
+         *
+         * \return The remaining lines.
+         */
+        std::string finish();
+
+        void reset();
+
+        /**
+         * Creates a GMime filter rendering the HTML passing through it.
+         */
+        static GMimeFilter * newFilter();
+
+    private:
+        enum class State
+        {
+            Text,
+            Tag,
+            Comment
+        };
+
+        void handleText(const std::string & text);
+        void handleTag(const std::string & tag);
+
+        void append(const std::string & text);
+        void startLine();
+        void endLine();
+        void breakLine();
+        void separateBlock();
+
+        std::string takeOutput();
+
+        static std::string decodeEntities(const std::string & text);
+        static std::string attribute(const std::string & tag, const std::string & name);
+
+        State _state;
+        std::string _pending;
+
+        std::string _output;
+        std::string _line;
+        bool _lineStarted;
+        bool _pendingSpace;
+        bool _blankLine;
+
+        /* The element whose content is being skipped, such as "script" */
+        std::string _skipping;
+
+        int _quoteDepth;
+        int _preDepth;
+
+        /* For each open list, the next item number, or 0 if unordered */
+        std::vector<int> _lists;
+
+        bool _firstCell;
+
+        std::string _link;
+        std::vector<std::string> _links;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -49,6 +49,11 @@ InputHandler::HandleResult InputHandler::handleKeySequence(const std::vector<int
 }
 
 void InputHandler::addHandledSequence(const std::string & string, const std::function<void ()> & function)
+{
+    _handledSequences[parseKeySequence(string)] = function;
+}
+
+std::vector<int> InputHandler::parseKeySequence(const std::string & string)
 {
     std::vector<int> sequence;
 
@@ -66,10 +71,10 @@ void InputHandler::addHandledSequence(const std::string & string, const std::fun
             sequence.push_back(*key);
     }
 
-    _handledSequences[sequence] = function;
+    return sequence;
 }
 
-int InputHandler::parseKey(const std::string & keyString) const
+int InputHandler::parseKey(const std::string & keyString)
 {
     if (keyString.size() == 3 && keyString.substr(0, 2) == "C-")
         return keyString[2] - 96;
@@ -117,8 +122,10 @@ int InputHandler::parseKey(const std::string & keyString) const
             { "PageDown",   KEY_NPAGE },
             { "PageUp",     KEY_PPAGE },
             { "Enter",      KEY_ENTER },
+            { "Return",     '\n' },
             { "BackTab",    KEY_BTAB },
             { "End",        KEY_END },
+            { "Timeout",    ERR },
         };
 
         auto key = keyMap.find(keyString);
@@ -62,11 +62,21 @@ class InputHandler
          */
         virtual HandleResult handleKeySequence(const std::vector<int> & sequence);
 
+        /**
+         * Parses a string into a key sequence.
+         *
+         * Strings surrounded in angle braces will be interpreted with parseKey.
+         *
+         * \param string The sequence of keys
+         * \return The keys for ncurses
+         */
+        static std::vector<int> parseKeySequence(const std::string & string);
+
     protected:
         /**
          * Add a new sequence to the set of handled key sequences.
          *
-         * Strings surrounded in angle braces will be interpreted with parseKey.
+         * The sequence is parsed with parseKeySequence.
          *
          * \param string The sequence of keys to handle
          * \param function The function to execute when the sequence is executed
@@ -81,7 +91,7 @@ class InputHandler
          *   - "Home"   : Home
          *   - "S-Home" : Shift Home
          */
-        int parseKey(const std::string & keyString) const;
+        static int parseKey(const std::string & keyString);
 
     private:
         std::map<std::vector<int>, std::function<void ()>> _handledSequences;
@@ -0,0 +1,81 @@
+/* ner: src/key_script.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <thread>
+
+#include "key_script.hh"
+#include "input_handler.hh"
+
+KeyScript::KeyScript(const std::string & path)
+{
+    std::ifstream file(path);
+
+    if (!file)
+        throw std::runtime_error("Could not open key script: " + path);
+
+    std::chrono::milliseconds delay(0);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        if (line.compare(0, 6, "@wait ") == 0)
+        {
+            try
+            {
+                delay += std::chrono::milliseconds(std::stoi(line.substr(6)));
+            }
+            catch (const std::logic_error &)
+            {
+                throw std::runtime_error("Invalid line in key script: " + line);
+            }
+
+            continue;
+        }
+
+        std::vector<int> sequence = InputHandler::parseKeySequence(line);
+
+        for (auto key = sequence.begin(), e = sequence.end(); key != e; ++key)
+        {
+            _steps.push_back(Step{ delay, *key });
+            delay = std::chrono::milliseconds(0);
+        }
+    }
+
+    _position = _steps.begin();
+}
+
+int KeyScript::nextKey()
+{
+    if (_position == _steps.end())
+        throw EndOfScriptException();
+
+    const Step & step = *_position++;
+
+    if (step.delay.count() > 0)
+        std::this_thread::sleep_for(step.delay);
+
+    return step.key;
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -0,0 +1,76 @@
+/* ner: src/key_script.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_KEY_SCRIPT_H
+#define NER_KEY_SCRIPT_H 1
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+/**
+ * Thrown when a KeyScript has no more keys.
+ */
+class EndOfScriptException : public std::exception
+{
+};
+
+/**
+ * A scripted sequence of keys, used in place of the keyboard when running
+ * headless.
+ *
+ * Each line of the script is a key sequence, written the same way as the key
+ * bindings, for example "j", "<PageDown>" or "tag:inbox<Return>". Blank lines
+ * and lines starting with '#' are ignored. A line of the form "@wait N" pauses
+ * for N milliseconds before the next key.
+ */
+class KeyScript
+{
+    public:
+        /**
+         * Loads the script from the given file.
+         *
+         * Throws a std::runtime_error if the file cannot be read, or a wait
+         * is not a number.
+         */
+        KeyScript(const std::string & path);
+
+        /**
+         * Returns the next key, waiting first if the script asks for it.
+         *
+         * Throws an EndOfScriptException when the script is exhausted.
+         */
+        int nextKey();
+
+    private:
+        struct Step
+        {
+            std::chrono::milliseconds delay;
+            int key;
+        };
+
+        std::vector<Step> _steps;
+        std::vector<Step>::const_iterator _position;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -0,0 +1,86 @@
+/* ner: src/latency_recorder.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iomanip>
+
+#include "latency_recorder.hh"
+#include "view.hh"
+
+LatencyRecorder * LatencyRecorder::_instance = 0;
+
+LatencyRecorder::Scope::Scope(const View & view, Event event)
+    : _view(view), _event(event)
+{
+    if (enabled())
+        _start = std::chrono::steady_clock::now();
+}
+
+LatencyRecorder::Scope::~Scope()
+{
+    if (enabled())
+    {
+        instance().record(_view.name(), _event, std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - _start));
+    }
+}
+
+LatencyRecorder::LatencyRecorder()
+{
+    _instance = this;
+}
+
+LatencyRecorder::~LatencyRecorder()
+{
+    _instance = 0;
+}
+
+void LatencyRecorder::record(const std::string & view, Event event, std::chrono::microseconds duration)
+{
+    _samples[std::make_pair(view, event)].push_back(duration);
+}
+
+void LatencyRecorder::report(std::ostream & stream) const
+{
+    const char * eventNames[] = { "update", "refresh", "key-to-paint" };
+
+    stream << std::left << std::setw(24) << "view" << std::setw(14) << "event"
+        << std::right << std::setw(8) << "count" << std::setw(10) << "p50"
+        << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+
+    for (auto samples = _samples.begin(), e = _samples.end(); samples != e; ++samples)
+    {
+        std::vector<std::chrono::microseconds> durations(samples->second);
+        std::sort(durations.begin(), durations.end());
+
+        /* Nearest-rank percentile */
+        auto percentile = [&durations](int p) {
+            return durations.at((durations.size() * p + 99) / 100 - 1).count();
+        };
+
+        stream << std::left << std::setw(24) << samples->first.first
+            << std::setw(14) << eventNames[static_cast<int>(samples->first.second)]
+            << std::right << std::setw(8) << durations.size()
+            << std::setw(10) << percentile(50) << std::setw(10) << percentile(99)
+            << std::setw(10) << durations.back().count() << std::endl;
+    }
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -0,0 +1,96 @@
+/* ner: src/latency_recorder.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_LATENCY_RECORDER_H
+#define NER_LATENCY_RECORDER_H 1
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <iostream>
+
+class View;
+
+/**
+ * Records how long views take to update and refresh.
+ *
+ * Recording only happens while an instance exists, which is the case when ner
+ * is run with --headless. Samples are taken on the user interface thread only.
+ *
+ * This class is a singleton.
+ */
+class LatencyRecorder
+{
+    public:
+        enum class Event
+        {
+            Update,
+            Refresh,
+            KeyToPaint
+        };
+
+        /**
+         * Records the time between its construction and destruction.
+         */
+        class Scope
+        {
+            public:
+                Scope(const View & view, Event event);
+                ~Scope();
+
+            private:
+                const View & _view;
+                Event _event;
+                std::chrono::steady_clock::time_point _start;
+        };
+
+        static bool enabled()
+        {
+            return _instance;
+        }
+
+        static LatencyRecorder & instance()
+        {
+            return *_instance;
+        }
+
+        LatencyRecorder();
+        ~LatencyRecorder();
+
+        void record(const std::string & view, Event event, std::chrono::microseconds duration);
+
+        /**
+         * Writes the sample count, p50, p99 and maximum latency, in
+         * microseconds, of each event for each view.
+         *
+         * \param stream The stream to write the report to.
+         */
+        void report(std::ostream & stream) const;
+
+    private:
+        static LatencyRecorder * _instance;
+
+        std::map<std::pair<std::string, Event>, std::vector<std::chrono::microseconds>> _samples;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -18,6 +18,8 @@
  */
 
 #include <sstream>
+#include <algorithm>
+#include <cstdlib>
 
 #include "line_browser_view.hh"
 #include "view_manager.hh"
@@ -25,8 +27,15 @@
 LineBrowserView::LineBrowserView(const View::Geometry & geometry)
     : WindowView(geometry),
         _selectedIndex(0),
-        _offset(0)
+        _offset(0),
+        _drawnOffset(0),
+        _drawnSelection(0),
+        _drawnLineCount(0),
+        _damaged(true)
 {
+    /* Let ncurses scroll the terminal rather than redraw every line */
+    idlok(_window, TRUE);
+
     /* Key Sequences */
     addHandledSequence("j",          std::bind(&LineBrowserView::next, this));
     addHandledSequence("<Down>",     std::bind(&LineBrowserView::next, this));
@@ -48,9 +57,18 @@ void LineBrowserView::resize(const View::Geometry & geometry)
 {
     WindowView::resize(geometry);
 
+    invalidate();
     makeSelectionVisible();
 }
 
+void LineBrowserView::focus()
+{
+    WindowView::focus();
+
+    /* The window still holds our lines, but another view was on the screen */
+    touchwin(_window);
+}
+
 std::vector<std::string> LineBrowserView::status() const
 {
     std::ostringstream position;
@@ -124,6 +142,108 @@ void LineBrowserView::makeSelectionVisible()
     StatusBar::instance().refresh();
 }
 
+void LineBrowserView::invalidate()
+{
+    _damaged = true;
+}
+
+void LineBrowserView::invalidateLine(int index)
+{
+    _damagedLines.push_back(index);
+}
+
+bool LineBrowserView::prepareUpdate(int top, std::vector<int> & lines)
+{
+    int height = visibleLines();
+    int count = lineCount();
+    bool all = _damaged;
+
+    if (!all && _offset != _drawnOffset)
+    {
+        int delta = _offset - _drawnOffset;
+
+        if (std::abs(delta) < height)
+        {
+            wsetscrreg(_window, top, top + height - 1);
+            scrollok(_window, TRUE);
+            wscrl(_window, delta);
+            scrollok(_window, FALSE);
+
+            /* The lines scrolled into view */
+            int first = delta > 0 ? _offset + height - delta : _offset;
+
+            for (int index = first; index < first + std::abs(delta); ++index)
+                _damagedLines.push_back(index);
+        }
+        else
+            all = true;
+    }
+
+    lines.clear();
+
+    if (all)
+    {
+        for (int index = _offset; index < _offset + height; ++index)
+            lines.push_back(index);
+    }
+    else
+    {
+        _damagedLines.push_back(_drawnSelection);
+        _damagedLines.push_back(_selectedIndex);
+
+        /* The visible lines which appeared or disappeared */
+        for (int index = std::max(_offset, std::min(count, _drawnLineCount)),
+            end = std::min(_offset + height, std::max(count, _drawnLineCount)); index < end; ++index)
+        {
+            _damagedLines.push_back(index);
+        }
+
+        std::sort(_damagedLines.begin(), _damagedLines.end());
+
+        for (auto index = _damagedLines.begin(), e = std::unique(_damagedLines.begin(), _damagedLines.end());
+            index != e; ++index)
+        {
+            if (*index >= _offset && *index < _offset + height)
+                lines.push_back(*index);
+        }
+    }
+
+    _damaged = false;
+    _damagedLines.clear();
+
+    _drawnOffset = _offset;
+    _drawnSelection = _selectedIndex;
+    _drawnLineCount = count;
+
+    return all;
+}
+
+void LineBrowserView::updateLines()
+{
+    std::vector<int> lines;
+    bool all = prepareUpdate(0, lines);
+    int count = lineCount();
+
+    if (all)
+        werase(_window);
+
+    for (auto index = lines.begin(), e = lines.end(); index != e; ++index)
+    {
+        if (!all)
+        {
+            wmove(_window, *index - _offset, 0);
+            wclrtoeol(_window);
+        }
+
+        if (*index < count)
+            displayLine(*index);
+    }
+}
+
+void LineBrowserView::displayLine(int index)
+{
+}
+
 int LineBrowserView::visibleLines() const
 {
     return getmaxy(_window);
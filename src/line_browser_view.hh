@@ -31,6 +31,7 @@ class LineBrowserView : public WindowView
         LineBrowserView(const View::Geometry & geometry = View::Geometry());
 
         virtual void resize(const View::Geometry & geometry = View::Geometry());
+        virtual void focus();
 
         virtual std::vector<std::string> status() const;
 
@@ -94,8 +95,54 @@ class LineBrowserView : public WindowView
          */
         virtual void makeSelectionVisible();
 
+        /**
+         * Marks every visible line as needing to be redrawn.
+         */
+        void invalidate();
+
+        /**
+         * Marks a line as needing to be redrawn, for example because its
+         * contents changed.
+         */
+        void invalidateLine(int index);
+
+        /**
+         * Works out which lines need to be redrawn since the last update.
+         *
+         * Besides the lines marked with invalidateLine, these are the lines
+         * where the selection was and is, and the lines which appeared or
+         * disappeared. If the offset changed by less than a screen, the window
+         * contents are scrolled, and only the lines scrolled in are redrawn.
+         *
+         * \param top The first window row showing lines
+         * \param lines Set to the visible lines to redraw, in order
+         * \return Whether the whole window needs to be redrawn
+         */
+        bool prepareUpdate(int top, std::vector<int> & lines);
+
+        /**
+         * Redraws the lines which need to be, using displayLine.
+         */
+        void updateLines();
+
+        /**
+         * Draws a single line on its (cleared) row.
+         *
+         * Reimplement this when using updateLines.
+         */
+        virtual void displayLine(int index);
+
         int _offset;
         int _selectedIndex;
+
+        /* The state of the window as of the last update */
+        int _drawnOffset;
+        int _drawnSelection;
+        int _drawnLineCount;
+
+    private:
+        bool _damaged;
+        std::vector<int> _damagedLines;
 };
 
 #endif
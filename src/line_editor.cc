@@ -58,7 +58,7 @@ std::string LineEditor::line(const std::string & field, const std::string & init
     auto notSpace = std::bind(std::logical_not<bool>(),
         std::bind(std::equal_to<char>(), ' ', std::placeholders::_1));
 
-    while ((c = getch()) != '\n')
+    while ((c = NCurses::readKey()) != '\n')
     {
         switch (c)
         {
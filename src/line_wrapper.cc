@@ -17,43 +17,102 @@
  * ner.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cwchar>
+
 #include "line_wrapper.hh"
 
 LineWrapper::LineWrapper(const std::string & string, int width)
-    : _start(string.begin()), _position(string.begin()), _end(string.end()),
-        _width(width), _done(false)
+    : LineWrapper(string.data(), string.size(), width)
 {
 }
 
-std::string LineWrapper::next()
+LineWrapper::LineWrapper(const char * string, std::string::size_type length, int width)
+    : _string(string), _length(length), _position(0), _width(width), _done(false)
 {
-    std::string line;
+}
+
+LineWrapper::Span LineWrapper::next()
+{
+    Span row{ _position, 0, 0 };
+
+    /* The end of the last word followed by a space, where the row could break */
+    std::string::size_type breakOffset = 0;
+    int breakWidth = 0;
+    bool canBreak = false;
 
-    if (_position + _width < _end)
+    std::string::size_type wordEnd = _position;
+    int wordEndWidth = 0;
+
+    std::string::size_type offset = _position;
+    int width = 0;
+    bool overflowed = false;
+
+    while (offset < _length)
     {
-        auto notSpace = std::bind(std::logical_not<bool>(),
-            std::bind(std::equal_to<char>(), ' ', std::placeholders::_1));
+        bool space = _string[offset] == ' ';
+
+        if (space)
+        {
+            if (wordEnd > _position)
+            {
+                breakOffset = wordEnd;
+                breakWidth = wordEndWidth;
+                canBreak = true;
+            }
+
+            /* A word too long for the row ends at the first space */
+            if (overflowed)
+                break;
+        }
 
-        auto lineEnd = std::find_if(std::find(
-            std::string::const_reverse_iterator(_position + _width + 1),
-            std::string::const_reverse_iterator(_position), ' '),
-            std::string::const_reverse_iterator(_position), notSpace).base();
+        std::string::size_type characterEnd = offset;
+        width += advance(characterEnd);
 
-        if (lineEnd == _position && (lineEnd = std::find(_position + _width, _end, ' ')) == _end)
-            _done = true;
+        if (width > _width && !overflowed)
+        {
+            if (canBreak)
+                break;
 
-        line = std::string(_position, lineEnd);
+            overflowed = true;
+        }
 
-        _position = std::find_if(lineEnd, _end, notSpace);
+        offset = characterEnd;
+
+        if (!space)
+        {
+            wordEnd = offset;
+            wordEndWidth = width;
+        }
     }
-    else
+
+    if (offset >= _length)
     {
-        line = std::string(_position, _end);
-        _position = _end;
+        row.length = _length - _position;
+        row.width = width;
+        _position = _length;
         _done = true;
+
+        return row;
+    }
+
+    if (overflowed)
+    {
+        breakOffset = wordEnd;
+        breakWidth = wordEndWidth;
     }
 
-    return line;
+    row.length = breakOffset - _position;
+    row.width = breakWidth;
+
+    /* Skip the spaces between this row and the next */
+    _position = breakOffset;
+    while (_position < _length && _string[_position] == ' ')
+        ++_position;
+
+    if (_position == _length)
+        _done = true;
+
+    return row;
 }
 
 bool LineWrapper::done() const
@@ -63,8 +122,36 @@ bool LineWrapper::done() const
 
 bool LineWrapper::wrapped() const
 {
-    return _position != _start;
+    return _position != 0;
 }
 
-// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+int LineWrapper::advance(std::string::size_type & offset) const
+{
+    unsigned char byte = _string[offset];
+
+    if (byte < 0x80)
+    {
+        ++offset;
+        return byte >= 0x20 && byte != 0x7f ? 1 : 0;
+    }
+
+    std::mbstate_t state = std::mbstate_t();
+    wchar_t character;
+
+    size_t bytesRead = std::mbrtowc(&character, _string + offset, _length - offset, &state);
 
+    /* Count an invalid byte as a single column, like a replacement character */
+    if (bytesRead == static_cast<size_t>(-1) || bytesRead == static_cast<size_t>(-2) || bytesRead == 0)
+    {
+        ++offset;
+        return 1;
+    }
+
+    offset += bytesRead;
+
+    int width = wcwidth(character);
+
+    return width > 0 ? width : 0;
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
@@ -21,22 +21,44 @@
 #define NER_LINE_WRAPPER_H 1
 
 #include <string>
-#include <algorithm>
-#include <functional>
 
+/**
+ * Splits a UTF-8 line into rows no wider than a number of columns.
+ *
+ * Rows are broken at spaces, and are returned as spans of the original line,
+ * so nothing is copied. A word wider than a row is left on a row of its own.
+ */
 class LineWrapper
 {
     public:
+        struct Span
+        {
+            std::string::size_type offset;
+            std::string::size_type length;
+
+            /* The number of columns taken up by the row */
+            int width;
+        };
+
         explicit LineWrapper(const std::string & string, int width = 80);
+        LineWrapper(const char * string, std::string::size_type length, int width = 80);
 
-        std::string next();
+        Span next();
         bool done() const;
         bool wrapped() const;
 
     private:
-        std::string::const_iterator _start;
-        std::string::const_iterator _position;
-        std::string::const_iterator _end;
+        /**
+         * Decodes the character at the given offset.
+         *
+         * \param offset The offset of the character, advanced past it.
+         * \return The number of columns taken up by the character.
+         */
+        int advance(std::string::size_type & offset) const;
+
+        const char * _string;
+        std::string::size_type _length;
+        std::string::size_type _position;
         int _width;
         bool _done;
 };
@@ -44,4 +66,3 @@ class LineWrapper
 #endif
 
 // vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
-
@@ -18,11 +18,15 @@
  */
 
 #include <cstdlib>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <functional>
 #include <clocale>
 #include <csignal>
 #include <unistd.h>
+#include <getopt.h>
 #include <gmime/gmime.h>
 
 #include "notmuch.hh"
@@ -31,10 +35,16 @@
 #include "search_list_view.hh"
 #include "identity_manager.hh"
 #include "ner_config.hh"
+#include "key_script.hh"
+#include "latency_recorder.hh"
+#include "event_loop.hh"
+#include "startup_trace.hh"
+#include "database_pool.hh"
+#include "tag_writer.hh"
 
 const std::string notmuchConfigFile(".notmuch-config");
 
-void resize(int arg)
+void resize()
 {
     endwin();
     refresh();
@@ -48,16 +58,36 @@ void resize(int arg)
     StatusBar::instance().update();
 
     ViewManager::instance().refresh();
-    StatusBar::instance().refresh();
-
-    /* Clear the -1 character */
-    getch();
 }
 
-void initialize()
+SCREEN * headlessScreen = NULL;
+
+/* The headless screen's terminal, closed once the screen is deleted */
+FILE * headlessOutput = NULL;
+FILE * headlessInput = NULL;
+
+void initialize(bool headless)
 {
     /* Initialize the screen */
-    initscr();
+    if (headless)
+    {
+        /* Draw to an offscreen terminal. The size can be set with the LINES
+         * and COLUMNS environment variables. */
+        const char * terminal = std::getenv("TERM");
+
+        headlessOutput = std::fopen("/dev/null", "w");
+        headlessInput = std::fopen("/dev/null", "r");
+
+        if (headlessOutput && headlessInput)
+            headlessScreen = newterm(terminal ? terminal : "xterm", headlessOutput, headlessInput);
+
+        if (headlessScreen == NULL)
+            throw std::runtime_error("Could not create headless screen");
+
+        set_term(headlessScreen);
+    }
+    else
+        initscr();
 
     /* Initialize colors */
     if (has_colors())
@@ -82,12 +112,66 @@ void initialize()
 void cleanup()
 {
     endwin();
+
+    if (headlessScreen)
+        delscreen(headlessScreen);
+
+    if (headlessOutput)
+        std::fclose(headlessOutput);
+
+    if (headlessInput)
+        std::fclose(headlessInput);
+}
+
+void usage(const char * program)
+{
+    std::cerr << "Usage: " << program << " [--headless SCRIPT] [--latency-report FILE] [--startup-trace]" << std::endl;
 }
 
 int main(int argc, char * argv[])
 {
     std::setlocale(LC_ALL, "");
 
+    std::string keyScriptPath;
+    std::string latencyReportPath;
+    bool startupTrace = false;
+
+    const struct option options[] = {
+        { "headless",       required_argument, NULL, 'H' },
+        { "latency-report", required_argument, NULL, 'L' },
+        { "startup-trace",  no_argument,       NULL, 'S' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int option;
+
+    while ((option = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch (option)
+        {
+            case 'H':
+                keyScriptPath = optarg;
+                break;
+            case 'L':
+                latencyReportPath = optarg;
+                break;
+            case 'S':
+                startupTrace = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    bool headless = !keyScriptPath.empty();
+
+    /* Time each phase of startup, printed when ner exits */
+    std::unique_ptr<StartupTrace> trace;
+
+    if (startupTrace)
+        trace.reset(new StartupTrace());
+
     srand(time(NULL));
     g_mime_init(0);
 
@@ -97,39 +181,114 @@ int main(int argc, char * argv[])
     const std::string & configPath = (environmentConfigPath != NULL &&
         access(environmentConfigPath, R_OK) == 0) ? environmentConfigPath : defaultConfigPath;
 
-    initialize();
+    /* Run from a scripted key sequence, recording view latency */
+    std::unique_ptr<KeyScript> keyScript;
+    std::unique_ptr<LatencyRecorder> latencyRecorder;
+
+    if (headless)
+    {
+        try
+        {
+            keyScript.reset(new KeyScript(keyScriptPath));
+        }
+        catch (const std::exception & e)
+        {
+            std::cerr << e.what() << std::endl;
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        latencyRecorder.reset(new LatencyRecorder());
+        NCurses::setKeySource(std::bind(&KeyScript::nextKey, keyScript.get()));
+    }
+
+    initialize(headless);
+
+    if (trace)
+        trace->record("initialize screen");
 
-    std::signal(SIGWINCH, &resize);
+    /* Taken before the pool and the TagWriter go away with Ner, for the
+     * trace */
+    DatabasePool::Statistics poolStatistics = DatabasePool::Statistics();
+    TagWriter::Statistics tagStatistics = TagWriter::Statistics();
 
     try
     {
-        Notmuch::initializeDatabase(configPath);
+        Notmuch::loadConfig(configPath);
         NerConfig::instance().load();
 
+        if (trace)
+            trace->record("load config");
+
+        /* Draw the first screen straight away, while the database is opened
+         * and the searches are counted in the background */
+        Ner ner;
+
+        EventLoop & eventLoop = EventLoop::instance();
+        eventLoop.setResizeHandler(&resize);
+
         if (NerConfig::instance().refreshView())
             /* Refresh the view every minute (or when the user presses a key). */
-            timeout(60000);
+            eventLoop.setIdleTimeout(60000);
 
-        Ner ner;
+        if (!headless)
+        {
+            /* Keys are read once the event loop sees them arrive */
+            nodelay(stdscr, TRUE);
+            NCurses::setKeySource(std::bind(&EventLoop::readKey, &eventLoop));
+        }
 
         std::shared_ptr<View> searchListView(new SearchListView());
         ner.viewManager().addView(searchListView);
 
-        ner.run();
+        if (trace)
+            trace->record("create views");
+
+        try
+        {
+            ner.run();
+        }
+        catch (const EndOfScriptException & e)
+        {
+        }
+
+        TagWriter::instance().flush();
+
+        poolStatistics = DatabasePool::instance().statistics();
+        tagStatistics = TagWriter::instance().statistics();
     }
     catch (const std::exception & e)
     {
         endwin();
-        Notmuch::closeDatabase();
 
         throw;
     }
 
-    Notmuch::closeDatabase();
-
     cleanup();
     g_mime_shutdown();
 
+    if (latencyRecorder)
+    {
+        if (latencyReportPath.empty() || latencyReportPath == "-")
+            latencyRecorder->report(std::cout);
+        else
+        {
+            std::ofstream report(latencyReportPath);
+            latencyRecorder->report(report);
+        }
+    }
+
+    if (trace)
+    {
+        trace->report(std::cerr);
+
+        std::cerr << std::endl << "database pool" << std::endl;
+        poolStatistics.report(std::cerr);
+
+        std::cerr << std::endl << "tag writes" << std::endl;
+        tagStatistics.report(std::cerr);
+    }
+
     return EXIT_SUCCESS;
 }
 
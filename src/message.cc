@@ -15,74 +15,129 @@ const char * InvalidMessageException::what() const throw()
     return ("Cannot find message with ID: " + _id).c_str();
 }
 
-Message::Message(notmuch_message_t * message)
+Message::Message(notmuch_message_t * message, const std::shared_ptr<void> & owner)
+    : _message(message), _owner(owner), _date(0),
+        _dateLoaded(false), _fromLoaded(false), _toLoaded(false), _subjectLoaded(false),
+        _tagsLoaded(false), _repliesLoaded(false)
 {
-    id       = notmuch_message_get_message_id(message);
-    filename = notmuch_message_get_filename(message);
-    date     = notmuch_message_get_date(message);
+}
 
+const std::string & Message::id() const
+{
+    if (_id.empty())
+        _id = notmuch_message_get_message_id(_message);
 
-    headers = {
-        { "From",    notmuch_message_get_header(message, "From")    ? : "(null)" },
-        { "To",      notmuch_message_get_header(message, "To")      ? : "(null)" },
-        { "Subject", notmuch_message_get_header(message, "Subject") ? : "(null)" },
-    };
+    return _id;
+}
 
+const std::string & Message::filename() const
+{
+    if (_filename.empty())
+        _filename = notmuch_message_get_filename(_message);
 
-    notmuch_tags_t * tagIterator;
-    for (tagIterator = notmuch_message_get_tags(message);
-        notmuch_tags_valid(tagIterator);
-        notmuch_tags_move_to_next(tagIterator))
+    return _filename;
+}
+
+time_t Message::date() const
+{
+    if (!_dateLoaded)
     {
-        tags.insert(notmuch_tags_get(tagIterator));
+        _date = notmuch_message_get_date(_message);
+        _dateLoaded = true;
     }
-    notmuch_tags_destroy(tagIterator);
 
+    return _date;
+}
 
-    notmuch_messages_t * messages;
-    for (messages = notmuch_message_get_replies(message);
-        notmuch_messages_valid(messages);
-        notmuch_messages_move_to_next(messages))
+static const std::string & loadHeader(notmuch_message_t * message, const char * name,
+    std::string & value, bool & loaded)
+{
+    /* Headers may be empty, so that can't mean they are not loaded yet */
+    if (!loaded)
     {
-        replies.push_back(Message(notmuch_messages_get(messages)));
+        value = notmuch_message_get_header(message, name) ? : "(null)";
+        loaded = true;
     }
-    notmuch_messages_destroy(messages);
+
+    return value;
 }
 
-void Message::removeTag(std::string tag)
+const std::string & Message::from() const
 {
-    auto message = Notmuch::message(id);
+    return loadHeader(_message, "From", _from, _fromLoaded);
+}
 
-    notmuch_message_remove_tag(message, tag.c_str());
-    tags.erase(tag);
+const std::string & Message::to() const
+{
+    return loadHeader(_message, "To", _to, _toLoaded);
+}
 
-    notmuch_message_destroy(message);
+const std::string & Message::subject() const
+{
+    return loadHeader(_message, "Subject", _subject, _subjectLoaded);
 }
 
-void Message::removeTagRecursive(std::string tag)
+const TagSet & Message::tags() const
 {
-    removeTag(tag);
+    if (!_tagsLoaded)
+    {
+        notmuch_tags_t * tagIterator;
+        for (tagIterator = notmuch_message_get_tags(_message);
+            notmuch_tags_valid(tagIterator);
+            notmuch_tags_move_to_next(tagIterator))
+        {
+            _tags.insert(notmuch_tags_get(tagIterator));
+        }
+        notmuch_tags_destroy(tagIterator);
+
+        _tagsLoaded = true;
+    }
 
-    for (Message m : replies) {
-        m.removeTagRecursive(tag);
+    return _tags;
+}
+
+const std::vector<Message> & Message::replies() const
+{
+    if (!_repliesLoaded)
+    {
+        notmuch_messages_t * messages;
+        for (messages = notmuch_message_get_replies(_message);
+            notmuch_messages_valid(messages);
+            notmuch_messages_move_to_next(messages))
+        {
+            _replies.push_back(Message(notmuch_messages_get(messages), _owner));
+        }
+        notmuch_messages_destroy(messages);
+
+        _repliesLoaded = true;
     }
+
+    return _replies;
 }
 
-void Message::addTag(std::string tag)
+std::vector<Message> & Message::replies()
 {
-    auto message = Notmuch::message(id);
+    return const_cast<std::vector<Message> &>(static_cast<const Message &>(*this).replies());
+}
 
-    notmuch_message_add_tag(message, tag.c_str());
-    tags.insert(tag);
+void Message::removeTag(std::string tag)
+{
+    tags();
+    _tags.erase(tag);
 
-    notmuch_message_destroy(message);
+    Notmuch::TagBatch batch;
+    batch.addMessage(id());
+    batch.removeTag(tag);
+    batch.commit();
 }
 
-void Message::addTagRecursive(std::string tag)
+void Message::addTag(std::string tag)
 {
-    addTag(tag);
+    tags();
+    _tags.insert(tag);
 
-    for (Message m : replies) {
-        m.addTagRecursive(tag);
-    }
+    Notmuch::TagBatch batch;
+    batch.addMessage(id());
+    batch.addTag(tag);
+    batch.commit();
 }
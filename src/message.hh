@@ -3,10 +3,10 @@
 
 #include <string>
 #include <vector>
-#include <map>
-#include <set>
+#include <memory>
 
 #include "notmuch.h"
+#include "tag_set.hh"
 
 
 class InvalidMessageException : public std::exception
@@ -57,7 +57,7 @@ template <class T>
             reference message = *messages.back();
             messages.pop_back();
 
-            for (auto reply = message.replies.rbegin(), e = message.replies.rend();
+            for (auto reply = message.replies().rbegin(), e = message.replies().rend();
                 reply != e; ++reply)
             {
                 messages.push_back(&*reply);
@@ -67,7 +67,7 @@ template <class T>
         bool operator==(const MessageTreeIterator & other) const
         {
             return messages.size() == other.messages.size() &&
-                (messages.size() == 0 || messages.back()->id == other.messages.back()->id);
+                (messages.size() == 0 || messages.back()->id() == other.messages.back()->id());
         }
 
         bool operator!=(const MessageTreeIterator & other) const
@@ -80,28 +80,73 @@ template <class T>
 };
 
 
+/**
+ * A handle to a message in the database.
+ *
+ * Only the notmuch message is held until a field is first accessed, at which
+ * point that field alone is loaded and cached. Replies are loaded the same way,
+ * so building the handles for a thread does not walk the whole reply tree.
+ */
 class Message
 {
     public:
         typedef MessageTreeIterator<Message> iterator;
         typedef MessageTreeIterator<const Message> const_iterator;
 
-        Message(notmuch_message_t * message);
-
+        /**
+         * \param message The notmuch message.
+         * \param owner Keeps the message, and the database it came from,
+         *              alive for as long as this handle (or a copy) exists.
+         */
+        Message(notmuch_message_t * message, const std::shared_ptr<void> & owner);
+
+        /**
+         * Changes a tag in the loaded tags straight away, and queues the
+         * change to be written to the database.
+         */
         void addTag(std::string tag);
-        void addTagRecursive(std::string tag);
-
         void removeTag(std::string tag);
-        void removeTagRecursive(std::string tag);
 
-        std::string id;
-        std::string filename;
+        const std::string & id() const;
+        const std::string & filename() const;
+        time_t date() const;
+
+        /**
+         * The headers indexed in the database. Each returns "(null)" if the
+         * header is not present.
+         */
+        const std::string & from() const;
+        const std::string & to() const;
+        const std::string & subject() const;
 
-        time_t date;
+        const TagSet & tags() const;
+        const std::vector<Message> & replies() const;
 
-        std::map<std::string, std::string> headers;
-        std::set<std::string> tags;
-        std::vector<Message> replies;
+        /**
+         * The replies, which may be changed, such as by tagging them.
+         */
+        std::vector<Message> & replies();
+
+    private:
+        notmuch_message_t * _message;
+        std::shared_ptr<void> _owner;
+
+        /* Lazily loaded fields */
+        mutable std::string _id;
+        mutable std::string _filename;
+        mutable time_t _date;
+        mutable std::string _from;
+        mutable std::string _to;
+        mutable std::string _subject;
+        mutable TagSet _tags;
+        mutable std::vector<Message> _replies;
+
+        mutable bool _dateLoaded;
+        mutable bool _fromLoaded;
+        mutable bool _toLoaded;
+        mutable bool _subjectLoaded;
+        mutable bool _tagsLoaded;
+        mutable bool _repliesLoaded;
 };
 
 #endif /* NER_MESSAGE_H */
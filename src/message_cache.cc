@@ -0,0 +1,208 @@
+/* ner: src/message_cache.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <sys/stat.h>
+
+#include "message_cache.hh"
+#include "ner_config.hh"
+#include "util.hh"
+
+MessageCache & MessageCache::instance()
+{
+    static MessageCache cache;
+
+    return cache;
+}
+
+MessageCache::MessageCache()
+    : _size(0), _budget(NerConfig::instance().messageCacheSize())
+{
+}
+
+MessageCache::~MessageCache()
+{
+}
+
+std::shared_ptr<const ParsedMessage> MessageCache::message(const std::string & filename)
+{
+    struct stat status;
+
+    if (stat(filename.c_str(), &status) != 0)
+        return std::shared_ptr<const ParsedMessage>();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto position = _index.find(filename);
+
+        if (position != _index.end())
+        {
+            EntryList::iterator entry = position->second;
+
+            if (entry->inode == status.st_ino &&
+                entry->modificationTime.tv_sec == status.st_mtim.tv_sec &&
+                entry->modificationTime.tv_nsec == status.st_mtim.tv_nsec &&
+                entry->fileSize == status.st_size)
+            {
+                /* Move it to the front */
+                _entries.splice(_entries.begin(), _entries, entry);
+
+                return entry->message;
+            }
+
+            /* The file has changed */
+            _size -= entry->size;
+            _entries.erase(entry);
+            _index.erase(position);
+        }
+    }
+
+    /* Parse without holding the lock, since this may run the html command */
+    std::shared_ptr<const ParsedMessage> message = parse(filename);
+
+    if (!message)
+        return message;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    /* Another thread may have parsed it in the mean time */
+    auto position = _index.find(filename);
+
+    if (position != _index.end())
+    {
+        _size -= position->second->size;
+        _entries.erase(position->second);
+        _index.erase(position);
+    }
+
+    size_t size = measure(*message);
+
+    _entries.push_front(Entry{ filename, status.st_ino, status.st_mtim, status.st_size, message, size });
+    _index[filename] = _entries.begin();
+    _size += size;
+
+    evict();
+
+    return message;
+}
+
+void MessageCache::remeasure(const std::string & filename)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto position = _index.find(filename);
+
+    if (position == _index.end())
+        return;
+
+    Entry & entry = *position->second;
+    size_t size = measure(*entry.message);
+
+    _size = _size - entry.size + size;
+    entry.size = size;
+
+    evict();
+}
+
+void MessageCache::evict()
+{
+    /* Always keep the most recent message, however large */
+    while (_size > _budget && _entries.size() > 1)
+    {
+        const Entry & entry = _entries.back();
+
+        _size -= entry.size;
+        _index.erase(entry.filename);
+        _entries.pop_back();
+    }
+}
+
+std::shared_ptr<const ParsedMessage> MessageCache::parse(const std::string & filename)
+{
+    FILE * file = fopen(filename.c_str(), "r");
+
+    if (file == NULL)
+        return std::shared_ptr<const ParsedMessage>();
+
+    /* Read the file into memory, so attachments kept by the cache do not hold
+     * it open */
+    GMimeStream * fileStream = g_mime_stream_file_new(file);
+    GMimeStream * stream = g_mime_stream_mem_new();
+    g_mime_stream_write_to_stream(fileStream, stream);
+    g_mime_stream_reset(stream);
+    g_object_unref(fileStream);
+
+    GMimeParser * parser = g_mime_parser_new_with_stream(stream);
+    GMimeMessage * message = g_mime_parser_construct_message(parser);
+
+    g_object_unref(parser);
+
+    std::shared_ptr<ParsedMessage> parsedMessage(new ParsedMessage);
+    parsedMessage->size = g_mime_stream_length(stream);
+
+    g_object_unref(stream);
+
+    if (message == NULL)
+        return std::shared_ptr<const ParsedMessage>();
+
+    /* Read relavant headers */
+    parsedMessage->headers = {
+        { "To",         internet_address_list_to_string(g_mime_message_get_recipients(message,
+            GMIME_RECIPIENT_TYPE_TO), true) ? : "(null)" },
+        { "From",       g_mime_message_get_sender(message) ? : "(null)" },
+        { "Cc",         internet_address_list_to_string(g_mime_message_get_recipients(message,
+            GMIME_RECIPIENT_TYPE_CC), true) ? : "(null)" },
+        { "Bcc",         internet_address_list_to_string(g_mime_message_get_recipients(message,
+            GMIME_RECIPIENT_TYPE_BCC), true) ? : "(null)" },
+        { "Subject",    g_mime_message_get_subject(message) ? : "(null)" }
+    };
+
+    /* Locate plain text parts */
+    processMimePart(g_mime_message_get_mime_part(message), std::back_inserter(parsedMessage->parts));
+
+    g_object_unref(message);
+
+    for (auto header = parsedMessage->headers.begin(), e = parsedMessage->headers.end();
+        header != e; ++header)
+    {
+        parsedMessage->size += header->first.size() + header->second.size();
+    }
+
+    return parsedMessage;
+}
+
+size_t MessageCache::measure(const ParsedMessage & message)
+{
+    size_t size = message.size;
+
+    for (auto part = message.parts.begin(), e = message.parts.end(); part != e; ++part)
+    {
+        if (const TextPart * textPart = dynamic_cast<const TextPart *>(part->get()))
+        {
+            for (auto line = textPart->lines.begin(), e = textPart->lines.end(); line != e; ++line)
+                size += sizeof(std::string) + line->capacity();
+        }
+    }
+
+    return size;
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -0,0 +1,119 @@
+/* ner: src/message_cache.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_MESSAGE_CACHE_H
+#define NER_MESSAGE_CACHE_H 1
+
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <ctime>
+#include <sys/stat.h>
+
+#include "message_part.hh"
+
+/**
+ * A message file, parsed into its headers and displayable parts.
+ */
+struct ParsedMessage
+{
+    std::map<std::string, std::string> headers;
+    std::vector<std::shared_ptr<MessagePart>> parts;
+
+    /* Approximate memory used by everything but the lines of the text parts,
+     * which may change once they are converted, in bytes */
+    size_t size;
+};
+
+/**
+ * A least recently used cache of parsed messages, shared by all the email
+ * views.
+ *
+ * Entries are keyed by the path of the message file, and are reparsed when the
+ * file's inode, modification time (to the nanosecond) or size changes, so
+ * that drafts rewritten within a second are picked up. Messages are evicted once the
+ * total size goes over the budget set by message_cache_size.
+ *
+ * This class is a singleton, and may be used from any thread.
+ */
+class MessageCache
+{
+    public:
+        static MessageCache & instance();
+
+        /**
+         * Returns the parsed message, parsing the file if it is not cached.
+         *
+         * \param filename The path of the message file.
+         * \return The message, or NULL if the file could not be read.
+         */
+        std::shared_ptr<const ParsedMessage> message(const std::string & filename);
+
+        /**
+         * Measures the cached message again, after its parts changed.
+         *
+         * \param filename The path of the message file.
+         */
+        void remeasure(const std::string & filename);
+
+    private:
+        struct Entry
+        {
+            std::string filename;
+            ino_t inode;
+            struct timespec modificationTime;
+            off_t fileSize;
+            std::shared_ptr<const ParsedMessage> message;
+
+            /* As measured when it was cached or last remeasured */
+            size_t size;
+        };
+
+        typedef std::list<Entry> EntryList;
+
+        MessageCache();
+        ~MessageCache();
+
+        static std::shared_ptr<const ParsedMessage> parse(const std::string & filename);
+
+        /**
+         * Returns the approximate memory used by the message, in bytes.
+         */
+        static size_t measure(const ParsedMessage & message);
+
+        void evict();
+
+        std::mutex _mutex;
+
+        /* Most recently used first */
+        EntryList _entries;
+        std::unordered_map<std::string, EntryList::iterator> _index;
+
+        size_t _size;
+        size_t _budget;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -17,64 +17,91 @@
  * ner.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <sstream>
+
 #include "message_part.hh"
 #include "ner_config.hh"
 #include "gmime_iostream.hh"
 #include "message_part_visitor.hh"
+#include "html_converter.hh"
+#include "html_renderer.hh"
+#include "line_wrapper.hh"
+#include "colors.hh"
+#include "event_loop.hh"
 
-#include <sys/types.h>
-#include <sys/wait.h>
+const std::string convertingMessage("[Converting HTML...]");
+
+static void readLines(std::istream & stream, std::vector<std::string> & lines)
+{
+    while (stream.good())
+    {
+        std::string line;
+        std::getline(stream, line);
+        for (std::size_t tab = 0; (tab = line.find('\t', tab)) != std::string::npos; ++tab)
+            line.replace(tab, 1, 8 - (tab % 8), ' ');
+        lines.push_back(line);
+    }
+}
 
 MessagePart::MessagePart(const std::string & id_)
-    : id(id_), folded(true)
+    : id(id_)
+{
+}
+
+bool MessagePart::update()
+{
+    return false;
+}
+
+void MessagePart::wait()
 {
 }
 
 TextPart::TextPart(GMimePart * part)
-    : MessagePart(g_mime_part_get_content_id(part) ? : std::string())
+    : MessagePart(g_mime_part_get_content_id(part) ? : std::string()), _layoutWidth(-1)
 {
     GMimeContentType * mimeContentType = g_mime_object_get_content_type(GMIME_OBJECT(part));
     contentType = g_mime_content_type_to_string(mimeContentType);
 
     GMimeStream * contentStream = NULL;
 
-    /* If this part is html text */
-    if (g_mime_content_type_is_type(mimeContentType, "text", "html"))
+    bool html = g_mime_content_type_is_type(mimeContentType, "text", "html");
+    bool externalHtml = !NerConfig::instance().command("html").empty() ||
+        !NerConfig::instance().command("html_server").empty();
+
+    /* If this part is html text, and an external converter is configured,
+     * show a placeholder until it has been converted in the background */
+    if (html && externalHtml)
     {
-        int readPipes[2];
-        int writePipes[2];
+        GMimeDataWrapper * content = g_mime_part_get_content_object(part);
 
-        pipe(readPipes);
-        pipe(writePipes);
+        GMimeStream * htmlStream = g_mime_stream_mem_new();
+        g_mime_data_wrapper_write_to_stream(content, htmlStream);
 
-        GMimeDataWrapper * content = g_mime_part_get_content_object(part);
+        GByteArray * htmlBytes = g_mime_stream_mem_get_byte_array(GMIME_STREAM_MEM(htmlStream));
+        std::string htmlText(reinterpret_cast<const char *>(htmlBytes->data), htmlBytes->len);
 
-        if (pid_t pid = fork())
-        {
-            close(writePipes[0]);
-            close(readPipes[1]);
+        g_object_unref(htmlStream);
 
-            GMimeStream * pipeStream = g_mime_stream_fs_new(writePipes[1]);
-            g_mime_data_wrapper_write_to_stream(content, pipeStream);
-            close(writePipes[1]);
+        std::shared_ptr<Conversion> conversion(new Conversion());
+        _conversion = conversion;
 
-            contentStream = g_mime_stream_fs_new(readPipes[0]);
-            g_mime_stream_fs_set_owner(GMIME_STREAM_FS(contentStream), true);
+        auto done = [conversion](const std::string & text) {
+            {
+                std::lock_guard<std::mutex> lock(conversion->mutex);
+                conversion->text = text;
+                conversion->done = true;
+            }
 
-            int status;
-            waitpid(pid, &status, 0);
-        }
-        else
-        {
-            close(readPipes[0]);
-            close(writePipes[1]);
+            conversion->finished.notify_all();
+            EventLoop::instance().wake();
+        };
 
-            dup2(readPipes[1], 1);
-            dup2(writePipes[0], 0);
+        HtmlConverter::instance().convertInBackground(htmlText, done);
 
-            execlp("sh", "sh", "-c", NerConfig::instance().command("html").c_str(), NULL);
-            exit(0);
-        }
+        lines.push_back(convertingMessage);
+
+        return;
     }
     /* If this part is text */
     else if (g_mime_content_type_is_type(mimeContentType, "text", "*"))
@@ -96,6 +123,14 @@ TextPart::TextPart(GMimePart * part)
             g_object_unref(filter);
         }
 
+        /* Otherwise, render html ourselves as it is decoded */
+        if (html)
+        {
+            GMimeFilter * filter = HtmlRenderer::newFilter();
+            g_mime_stream_filter_add(GMIME_STREAM_FILTER(filteredStream), filter);
+            g_object_unref(filter);
+        }
+
         g_mime_stream_reset(stream);
 
         contentStream = filteredStream;
@@ -112,14 +147,48 @@ TextPart::TextPart(GMimePart * part)
     GMimeIOStream stream(contentStream);
     g_object_unref(contentStream);
 
-    while (stream.good())
+    readLines(stream, lines);
+}
+
+bool TextPart::update()
+{
+    if (!_conversion)
+        return false;
+
+    std::string text;
+
     {
-        std::string line;
-        std::getline(stream, line);
-        for (std::size_t tab = 0; (tab = line.find('\t', tab)) != std::string::npos; ++tab)
-            line.replace(tab, 1, 8 - (tab % 8), ' ');
-        lines.push_back(line);
+        std::lock_guard<std::mutex> lock(_conversion->mutex);
+
+        if (!_conversion->done)
+            return false;
+
+        text.swap(_conversion->text);
     }
+
+    _conversion.reset();
+
+    std::istringstream stream(text);
+
+    lines.clear();
+    readLines(stream, lines);
+
+    _layoutWidth = -1;
+
+    return true;
+}
+
+void TextPart::wait()
+{
+    if (!_conversion)
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock(_conversion->mutex);
+        _conversion->finished.wait(lock, [this] { return _conversion->done; });
+    }
+
+    update();
 }
 
 void TextPart::accept(MessagePartVisitor & visitor)
@@ -127,6 +196,52 @@ void TextPart::accept(MessagePartVisitor & visitor)
     visitor.visit(*this);
 }
 
+const std::vector<TextPart::Row> & TextPart::layout(int width) const
+{
+    if (width == _layoutWidth)
+        return _layout;
+
+    _layout.clear();
+    _layout.reserve(lines.size());
+    _layoutWidth = width;
+
+    for (unsigned index = 0; index < lines.size(); ++index)
+    {
+        const std::string & line = lines[index];
+
+        unsigned citationLevel = 0;
+        for (auto character = line.begin(); character != line.end(); ++character)
+        {
+            if (*character == '>')
+                ++citationLevel;
+            else if (*character != ' ')
+                break;
+        }
+
+        short color = 0;
+        if (citationLevel)
+        {
+            switch (citationLevel % 4)
+            {
+                case 1: color = ColorID::CitationLevel1; break;
+                case 2: color = ColorID::CitationLevel2; break;
+                case 3: color = ColorID::CitationLevel3; break;
+                case 0: color = ColorID::CitationLevel4; break;
+            }
+        }
+
+        for (auto lineWrapper = LineWrapper(line, width); !lineWrapper.done();)
+        {
+            bool wrapped = lineWrapper.wrapped();
+            LineWrapper::Span span = lineWrapper.next();
+
+            _layout.push_back(Row{ index, unsigned(span.offset), unsigned(span.length), color, wrapped });
+        }
+    }
+
+    return _layout;
+}
+
 Attachment::Attachment(GMimePart * part)
     : MessagePart(g_mime_part_get_content_id(part) ? : std::string()),
         filename(g_mime_part_get_filename(part) ? : std::string()),
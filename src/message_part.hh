@@ -22,6 +22,9 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
 #include <stdexcept>
 #include <gmime/gmime.h>
 
@@ -36,18 +39,79 @@ struct MessagePart
 
     virtual void accept(MessagePartVisitor & visitor) = 0;
 
-    bool folded;
+    /**
+     * Takes in content finished in the background since the last call.
+     *
+     * This must be called from the UI thread.
+     *
+     * \return Whether the part changed.
+     */
+    virtual bool update();
+
+    /**
+     * Waits for content being produced in the background, and takes it in,
+     * for callers which need the final content rather than a placeholder.
+     */
+    virtual void wait();
+
     std::string id;
 };
 
 struct TextPart : public MessagePart
 {
+    /**
+     * Reads the text of the part.
+     *
+     * HTML parts with an external converter are converted in the background
+     * by the HtmlConverter. Until then, the part holds a placeholder line,
+     * replaced by update().
+     */
     TextPart(GMimePart * part);
 
     virtual void accept(MessagePartVisitor & visitor);
+    virtual bool update();
+    virtual void wait();
+
+    /**
+     * A displayed row: part of a line, once wrapped.
+     */
+    struct Row
+    {
+        unsigned line;
+        unsigned offset;
+        unsigned length;
+        short color;
+        bool wrapped;
+    };
+
+    /**
+     * Lays out the lines of this part wrapped to the given width.
+     *
+     * The layout is kept until it is requested with a different width, so
+     * scrolling only costs as much as the rows actually drawn.
+     *
+     * \param width The width to wrap lines at
+     * \return Every row of the part, in order
+     */
+    const std::vector<Row> & layout(int width) const;
 
     std::vector<std::string> lines;
     std::string contentType;
+
+    private:
+        /* Shared with the job converting the part, which may outlive it */
+        struct Conversion
+        {
+            std::mutex mutex;
+            std::condition_variable finished;
+            bool done;
+            std::string text;
+        };
+
+        mutable int _layoutWidth;
+        mutable std::vector<Row> _layout;
+
+        std::shared_ptr<Conversion> _conversion;
 };
 
 struct Attachment : public MessagePart
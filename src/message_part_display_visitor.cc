@@ -18,6 +18,7 @@
  */
 
 #include <sstream>
+#include <algorithm>
 
 #include "message_part_display_visitor.hh"
 #include "colors.hh"
@@ -28,23 +29,27 @@
 const int wrapWidth(80);
 
 MessagePartDisplayVisitor::MessagePartDisplayVisitor(WINDOW * window,
-    const View::Geometry & area, int offset, int selection, bool displayPartName)
-    : _window(window), _area(area), _offset(offset), _row(area.y), _messageRow(0),
-        _selection(selection), _displayPartName(displayPartName)
+    const View::Geometry & area, int offset, int selection,
+    const std::vector<int> & lines, const std::vector<bool> & folded, bool displayPartName)
+    : _window(window), _area(area), _offset(offset), _messageRow(0),
+        _selection(selection), _lines(lines), _folded(folded), _part(0),
+        _displayPartName(displayPartName)
 {
 }
 
 void MessagePartDisplayVisitor::visit(const TextPart & part)
 {
-    if (_messageRow >= _offset && _row < _area.y + _area.height && _displayPartName)
+    bool folded = _folded.at(_part++);
+
+    if (_displayPartName && drawn(_messageRow))
     {
         bool selected = _messageRow == _selection;
 
         int x = _area.x;
-        wmove(_window, _row++, _area.x);
+        wmove(_window, _area.y + _messageRow - _offset, _area.x);
 
         attr_t attributes = 0;
-        x += NCurses::addChar(_window, part.folded ? '+' : '-',
+        x += NCurses::addChar(_window, folded ? '+' : '-',
                               A_BOLD | attributes, ColorID::AttachmentFilename);
         NCurses::checkMove(_window, ++x);
 
@@ -60,71 +65,63 @@ void MessagePartDisplayVisitor::visit(const TextPart & part)
         x += NCurses::addPlainString(_window, part.contentType, attributes,
                                      ColorID::AttachmentMimeType);
         NCurses::checkMove(_window, x - 1);
-        ++_messageRow;
     }
-    if (part.folded)
+
+    if (_displayPartName)
+        ++_messageRow;
+
+    if (folded)
         return;
 
-    for (auto line = part.lines.begin(), e = part.lines.end(); line != e; ++line)
-    {
-        unsigned citationLevel = 0;
-        for (auto character = line->begin(); character != line->end(); ++character)
-        {
-            if (*character == '>')
-                ++citationLevel;
-            else if (*character != ' ')
-                break;
-        }
+    const std::vector<TextPart::Row> & rows = part.layout(_area.width - 1);
 
-        short color = 0;
-        if (citationLevel)
-        {
-            switch (citationLevel % 4)
-            {
-                case 1: color = ColorID::CitationLevel1; break;
-                case 2: color = ColorID::CitationLevel2; break;
-                case 3: color = ColorID::CitationLevel3; break;
-                case 0: color = ColorID::CitationLevel4; break;
-            }
-        }
+    int partRow = _messageRow;
 
-        for (auto lineWrapper = LineWrapper(*line, _area.width-1); !lineWrapper.done(); ++_messageRow)
-        {
-            bool selected = _messageRow == _selection;
-            bool wrapped = lineWrapper.wrapped();
+    /* Only visit the rows which are visible */
+    int first = std::max(0, std::min<int>(_offset - partRow, rows.size()));
 
-            std::string wrappedLine(lineWrapper.next());
+    for (auto row = rows.begin() + first, e = rows.end();
+        row != e && partRow + (row - rows.begin()) < _offset + _area.height; ++row)
+    {
+        int index = partRow + (row - rows.begin());
 
-            if (_messageRow < _offset || _row >= _area.y + _area.height)
-                continue;
+        if (!drawn(index))
+            continue;
 
-            if (wrapped)
-                mvwaddch(_window, _row, _area.x, ACS_CKBOARD | COLOR_PAIR(ColorID::LineWrapIndicator));
+        bool selected = index == _selection;
+        int windowRow = _area.y + index - _offset;
 
-            wmove(_window, _row, _area.x + 2);
+        if (row->wrapped)
+            mvwaddch(_window, windowRow, _area.x, ACS_CKBOARD | COLOR_PAIR(ColorID::LineWrapIndicator));
 
-            attr_t attributes = 0;
+        wmove(_window, windowRow, _area.x + 2);
 
-            if (selected)
-            {
-                attributes |= A_REVERSE;
-                wchgat(_window, _area.width - 2, A_REVERSE, 0, NULL);
-            }
+        attr_t attributes = 0;
 
-            if (NCurses::addUtf8String(_window, wrappedLine.c_str(), attributes, color) >
-                _area.width - _area.y - 2)
-            {
-                NCurses::addCutOffIndicator(_window, attributes);
-            }
+        if (selected)
+        {
+            attributes |= A_REVERSE;
+            wchgat(_window, _area.width - 2, A_REVERSE, 0, NULL);
+        }
 
-            ++_row;
+        const char * line = part.lines[row->line].data() + row->offset;
+
+        if (NCurses::addUtf8String(_window, line, line + row->length,
+            attributes, row->color) >
+            _area.width - _area.y - 2)
+        {
+            NCurses::addCutOffIndicator(_window, attributes);
         }
     }
+
+    _messageRow = partRow + rows.size();
 }
 
 void MessagePartDisplayVisitor::visit(const Attachment & part)
 {
-    if (_messageRow >= _offset && _row < _area.y + _area.height)
+    ++_part;
+
+    if (drawn(_messageRow))
     {
         try
         {
@@ -132,7 +129,7 @@ void MessagePartDisplayVisitor::visit(const Attachment & part)
 
             int x = _area.x;
 
-            wmove(_window, _row++, _area.x);
+            wmove(_window, _area.y + _messageRow - _offset, _area.x);
 
             attr_t attributes = 0;
 
@@ -170,14 +167,15 @@ void MessagePartDisplayVisitor::visit(const Attachment & part)
     ++_messageRow;
 }
 
-int MessagePartDisplayVisitor::row() const
+int MessagePartDisplayVisitor::lines() const
 {
-    return _row;
+    return _messageRow;
 }
 
-int MessagePartDisplayVisitor::lines() const
+bool MessagePartDisplayVisitor::drawn(int index) const
 {
-    return _messageRow;
+    return index >= _offset && index < _offset + _area.height &&
+        std::binary_search(_lines.begin(), _lines.end(), index);
 }
 
 // vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
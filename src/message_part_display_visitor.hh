@@ -24,25 +24,42 @@
 #include "ncurses.hh"
 #include "view.hh"
 
+/**
+ * Draws message parts, and counts the lines they take up.
+ */
 class MessagePartDisplayVisitor : public MessagePartVisitor
 {
     public:
+        /**
+         * \param lines The lines to draw, in order. Their rows must already be
+         *              cleared.
+         * \param folded Whether each of the parts to be visited is folded.
+         */
         MessagePartDisplayVisitor(WINDOW * window, const View::Geometry & area,
-            int offset, int selection, bool displayPartName);
+            int offset, int selection, const std::vector<int> & lines,
+            const std::vector<bool> & folded, bool displayPartName);
 
         virtual void visit(const TextPart & part);
         virtual void visit(const Attachment & part);
 
-        int row() const;
         int lines() const;
 
     private:
+        /**
+         * Returns whether the line at the given index should be drawn.
+         */
+        bool drawn(int index) const;
+
         WINDOW * _window;
         View::Geometry _area;
-        int _row;
         int _messageRow;
         int _offset;
         int _selection;
+        const std::vector<int> & _lines;
+        const std::vector<bool> & _folded;
+
+        /* The index of the part being visited */
+        int _part;
 
         bool _displayPartName;
 };
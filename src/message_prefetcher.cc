@@ -0,0 +1,89 @@
+/* ner: src/message_prefetcher.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <functional>
+
+#include "message_prefetcher.hh"
+#include "message_cache.hh"
+
+MessagePrefetcher * MessagePrefetcher::_instance = 0;
+
+MessagePrefetcher::MessagePrefetcher()
+    : _running(true)
+{
+    _instance = this;
+
+    _thread = std::thread(std::bind(&MessagePrefetcher::run, this));
+}
+
+MessagePrefetcher::~MessagePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+        _queue.clear();
+    }
+
+    _condition.notify_one();
+    _thread.join();
+
+    _instance = 0;
+}
+
+void MessagePrefetcher::prefetch(const std::vector<std::string> & filenames)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.assign(filenames.begin(), filenames.end());
+    }
+
+    _condition.notify_one();
+}
+
+void MessagePrefetcher::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _condition.wait(lock, [this] { return !_queue.empty() || !_running; });
+
+        if (!_running)
+            break;
+
+        std::string filename = _queue.front();
+        _queue.pop_front();
+
+        lock.unlock();
+
+        try
+        {
+            MessageCache::instance().message(filename);
+        }
+        catch (const std::exception & e)
+        {
+            /* The view will report the error if the message is opened */
+        }
+
+        lock.lock();
+    }
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -0,0 +1,74 @@
+/* ner: src/message_prefetcher.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_MESSAGE_PREFETCHER_H
+#define NER_MESSAGE_PREFETCHER_H 1
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Parses messages into the MessageCache in the background, so that they can
+ * be shown without delay when they are opened.
+ *
+ * This class is a singleton.
+ */
+class MessagePrefetcher
+{
+    public:
+        static MessagePrefetcher & instance()
+        {
+            return *_instance;
+        }
+
+        MessagePrefetcher();
+
+        /**
+         * Stops prefetching, waiting for the message being parsed, if any.
+         */
+        ~MessagePrefetcher();
+
+        /**
+         * Replaces the queued messages with the given ones.
+         *
+         * \param filenames The message files, most wanted first.
+         */
+        void prefetch(const std::vector<std::string> & filenames);
+
+    private:
+        static MessagePrefetcher * _instance;
+
+        void run();
+
+        std::thread _thread;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+
+        bool _running;
+        std::deque<std::string> _queue;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -32,8 +32,7 @@ MessageView::~MessageView()
 
 void MessageView::setMessage(const std::string & messageId)
 {
-    Message & message = Notmuch::getMessage(messageId);
-    setEmail(message.filename);
+    setEmail(Notmuch::getMessage(messageId).filename());
 }
 
 // vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
@@ -17,10 +17,168 @@
  * ner.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <vector>
+#include <string>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#   include <emmintrin.h>
+#endif
+
 #include "ncurses.hh"
 
 using namespace NCurses;
 
+std::function<int ()> _keySource;
+
+namespace
+{
+    struct CachedString
+    {
+        std::string string;
+        attr_t attributes;
+        short color;
+        int maxLength;
+
+        /* The converted characters, up to the point where the string is cut off */
+        std::vector<cchar_t> characters;
+        int displayLength;
+    };
+
+    const std::size_t stringCacheSize = 256;
+    const std::size_t maxCachedLength = 256;
+
+    CachedString stringCache[stringCacheSize];
+
+    /* Reused from call to call, rather than allocated each time */
+    std::vector<chtype> plainCharacters;
+    std::vector<cchar_t> displayCharacters;
+
+    inline bool isPrintableAscii(char character)
+    {
+        unsigned char byte = character;
+        return byte >= ' ' && byte < 0x7f;
+    }
+
+    /**
+     * Finds the length of the run of printable ASCII characters at the start
+     * of a string.
+     */
+    std::size_t printableAsciiLength(const char * first, const char * last)
+    {
+        const char * position = first;
+
+#ifdef __SSE2__
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i del = _mm_set1_epi8(0x7f);
+
+        for (; last - position >= 16; position += 16)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(position));
+
+            /* Bytes from 0x80 up are negative, so they compare less than a space */
+            int special = _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(bytes, space),
+                _mm_cmpeq_epi8(bytes, del)));
+
+            if (special != 0)
+                return position - first + __builtin_ctz(special);
+        }
+#endif
+
+        while (position != last && isPrintableAscii(*position))
+            ++position;
+
+        return position - first;
+    }
+
+    /**
+     * Converts a UTF-8 string to a NULL terminated array of cchar_t.
+     *
+     * \return The number of columns taken up by the string, including the
+     *         first character which did not fit.
+     */
+    int convertUtf8String(const char * first, const char * last, attr_t attributes,
+        short color, int maxLength, std::vector<cchar_t> & displayCharacters)
+    {
+        mbstate_t state = { 0 };
+
+        const char * string = first;
+        std::size_t length = last - first;
+
+        displayCharacters.clear();
+        int displayLength = 0;
+
+        cchar_t displayCharacter;
+        wchar_t wideCharacters[CCHARW_MAX + 1];
+        wchar_t wideCharacter;
+        int wideIndex = 0;
+
+        for (std::size_t position = 0; position < length;)
+        {
+            int bytesRead;
+            int width;
+
+            /* Skip the conversion for plain ASCII */
+            if (isPrintableAscii(string[position]))
+            {
+                wideCharacter = string[position];
+                bytesRead = 1;
+                width = 1;
+            }
+            else
+            {
+                bytesRead = std::mbrtowc(&wideCharacter,
+                    string + position, length - position, &state);
+
+                if (bytesRead < 0)
+                    break;
+
+                width = wcwidth(wideCharacter);
+            }
+
+            position += bytesRead;
+
+            if (width > 0)
+                displayLength += width;
+
+            if (displayLength > maxLength)
+                break;
+
+            /* We found a new spacing character, set the next cchar_t */
+            if ((width > 0 && wideIndex > 0) || wideIndex == CCHARW_MAX)
+            {
+                wideCharacters[wideIndex] = L'\0';
+                setcchar(&displayCharacter, wideCharacters, attributes, color, NULL);
+                displayCharacters.push_back(displayCharacter);
+
+                /* Start the next display character */
+                wideIndex = 0;
+            }
+            else if (width == 0 && wideIndex == 0)
+                wideCharacters[wideIndex++] = L' ';
+            else if (width < 0)
+                break;
+
+            wideCharacters[wideIndex++] = wideCharacter;
+        }
+
+        if (wideIndex > 0)
+        {
+            wideCharacters[wideIndex] = L'\0';
+            setcchar(&displayCharacter, wideCharacters, attributes, color, NULL);
+            displayCharacters.push_back(displayCharacter);
+        }
+
+        /* Set the NULL cchar_t */
+        wideCharacters[0] = L'\0';
+        setcchar(&displayCharacter, wideCharacters, 0, 0, NULL);
+        displayCharacters.push_back(displayCharacter);
+
+        return displayLength;
+    }
+}
+
 CutOffException::~CutOffException() throw ()
 {
 }
@@ -57,68 +215,72 @@ int NCurses::addPlainString(WINDOW * window, const char * string,
 int NCurses::addUtf8String(WINDOW * window, const char * string,
     attr_t attributes, short color, int maxLength)
 {
-    mbstate_t state = { 0 };
+    return addUtf8String(window, string, string + std::strlen(string), attributes, color, maxLength);
+}
 
-    int length = strlen(string);
+int NCurses::addUtf8String(WINDOW * window, const char * first, const char * last,
+    attr_t attributes, short color, int maxLength)
+{
+    std::size_t length = last - first;
 
-    cchar_t displayCharacters[length + 1];
-    int displayIndex = 0;
-    int displayLength = 0;
+    /* Printable ASCII maps straight to one column per byte */
+    if (printableAsciiLength(first, last) == length)
+    {
+        int count = std::min<std::size_t>(length, maxLength);
+        chtype mask = attributes | COLOR_PAIR(color);
 
-    wchar_t wideCharacters[CCHARW_MAX + 1];
-    wchar_t wideCharacter;
-    int wideIndex = 0;
+        plainCharacters.resize(count);
 
-    for (int position = 0; position < length;)
-    {
-        int bytesRead = std::mbrtowc(&wideCharacter,
-            string + position, length - position, &state);
+        for (int index = 0; index < count; ++index)
+            plainCharacters[index] = static_cast<unsigned char>(first[index]) | mask;
 
-        position += bytesRead;
+        waddchnstr(window, plainCharacters.data(), count);
 
-        if (bytesRead < 0)
-            break;
+        /* Like below, count the first character which did not fit */
+        return length > std::size_t(maxLength) ? maxLength + 1 : count;
+    }
 
-        int width = wcwidth(wideCharacter);
+    int displayLength = convertUtf8String(first, last, attributes, color, maxLength,
+        displayCharacters);
+    wadd_wchnstr(window, displayCharacters.data(), displayCharacters.size() - 1);
 
-        if (width > 0)
-            displayLength += width;
+    return displayLength;
+}
 
-        if (displayLength > maxLength)
-            break;
+int NCurses::addCachedUtf8String(WINDOW * window, const char * string,
+    attr_t attributes, short color, int maxLength)
+{
+    const char * first = string;
+    const char * last = string + std::strlen(string);
+    std::size_t length = last - first;
 
-        /* We found a new spacing character, set the next cchar_t */
-        if ((width > 0 && wideIndex > 0) || wideIndex == CCHARW_MAX)
-        {
-            wideCharacters[wideIndex] = L'\0';
-            setcchar(&displayCharacters[displayIndex++], wideCharacters,
-                attributes, color, NULL);
+    if (length > maxCachedLength || printableAsciiLength(first, last) == length)
+        return addUtf8String(window, first, last, attributes, color, maxLength);
 
-            /* Start the next display character */
-            wideIndex = 0;
-        }
-        else if (width == 0 && wideIndex == 0)
-            wideCharacters[wideIndex++] = L' ';
-        else if (width < 0)
-            break;
+    std::size_t hash = 2166136261u;
 
-        wideCharacters[wideIndex++] = wideCharacter;
-    }
+    for (const char * character = first; character != last; ++character)
+        hash = (hash ^ static_cast<unsigned char>(*character)) * 16777619u;
+
+    hash ^= attributes ^ (color << 8) ^ maxLength;
 
-    if (wideIndex > 0)
+    CachedString & cached = stringCache[hash % stringCacheSize];
+
+    if (cached.characters.empty() || cached.attributes != attributes || cached.color != color ||
+        cached.maxLength != maxLength || cached.string.size() != length ||
+        std::memcmp(cached.string.data(), first, length) != 0)
     {
-        wideCharacters[wideIndex] = L'\0';
-        setcchar(&displayCharacters[displayIndex++], wideCharacters,
-            attributes, color, NULL);
+        cached.string.assign(first, last);
+        cached.attributes = attributes;
+        cached.color = color;
+        cached.maxLength = maxLength;
+        cached.displayLength = convertUtf8String(first, last, attributes, color, maxLength,
+            cached.characters);
     }
 
-    /* Set the NULL cchar_t */
-    wideCharacters[0] = L'\0';
-    setcchar(&displayCharacters[displayIndex], wideCharacters, 0, 0, NULL);
-
-    wadd_wchnstr(window, displayCharacters, displayIndex);
+    wadd_wchnstr(window, cached.characters.data(), cached.characters.size() - 1);
 
-    return displayLength;
+    return cached.displayLength;
 }
 
 int NCurses::addChar(WINDOW * window, chtype character, int attributes, short color)
@@ -128,5 +290,25 @@ int NCurses::addChar(WINDOW * window, chtype character, int attributes, short co
     return 1;
 }
 
+int NCurses::readKey()
+{
+    return _keySource ? _keySource() : getch();
+}
+
+bool NCurses::inputPending()
+{
+    if (_keySource)
+        return false;
+
+    struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+
+    return poll(&input, 1, 0) > 0;
+}
+
+void NCurses::setKeySource(const std::function<int ()> & source)
+{
+    _keySource = source;
+}
+
 // vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
 
@@ -26,6 +26,7 @@
 #include <algorithm>
 #include <locale>
 #include <cstring>
+#include <functional>
 
 #if HAVE_NCURSESW_NCURSES_H
 #   include <ncursesw/ncurses.h>
@@ -131,6 +132,24 @@ namespace NCurses
     int addUtf8String(WINDOW * window, const char * string,
         attr_t attributes = 0, short color = 0, int maxLength = std::numeric_limits<int>::max());
 
+    /**
+     * \overload
+     *
+     * \param first A pointer to the first byte of the string.
+     * \param last A pointer to the end of the string.
+     */
+    int addUtf8String(WINDOW * window, const char * first, const char * last,
+        attr_t attributes = 0, short color = 0, int maxLength = std::numeric_limits<int>::max());
+
+    /**
+     * Like addUtf8String, but keeps the converted characters of short
+     * strings in a small cache, for strings which are drawn over and over
+     * again, such as authors and subjects. Message bodies should not go
+     * through it, so that they do not evict those strings.
+     */
+    int addCachedUtf8String(WINDOW * window, const char * string,
+        attr_t attributes = 0, short color = 0, int maxLength = std::numeric_limits<int>::max());
+
     /**
      * Adds a single character to the window.
      *
@@ -143,6 +162,25 @@ namespace NCurses
      */
     int addChar(WINDOW * window, chtype character,
         int attributes = 0, short color = 0);
+
+    /**
+     * Reads the next key of input.
+     *
+     * This is getch, unless a key source has been set.
+     */
+    int readKey();
+
+    /**
+     * Returns whether more keys are waiting to be read from the terminal.
+     */
+    bool inputPending();
+
+    /**
+     * Sets where readKey gets its keys from instead of the terminal.
+     *
+     * \param source A function returning the next key.
+     */
+    void setKeySource(const std::function<int ()> & source);
 };
 
 #endif
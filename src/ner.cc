@@ -18,6 +18,7 @@
  */
 
 #include <iostream>
+#include <chrono>
 #include <sys/types.h>
 #include <signal.h>
 
@@ -35,6 +36,12 @@
 #include "notmuch.hh"
 #include "line_editor.hh"
 #include "message.hh"
+#include "latency_recorder.hh"
+#include "startup_trace.hh"
+#include "html_converter.hh"
+
+/* While keys arrive faster than this, frames are only drawn this often */
+const auto frameInterval = std::chrono::milliseconds(16);
 
 Ner::Ner()
 {
@@ -47,10 +54,17 @@ Ner::Ner()
     addHandledSequence(";",     std::bind(&Ner::openViewView, this));
     addHandledSequence("<C-l>", std::bind(&Ner::redraw, this));
     addHandledSequence("<C-z>", std::bind(&kill, getpid(), SIGTSTP));
+
+    /* Opened in the background, once the event loop exists to hear about it */
+    Notmuch::initializeDatabase();
 }
 
 Ner::~Ner()
 {
+    /* Background conversions wake the event loop once they finish */
+    HtmlConverter::instance().stop();
+
+    Notmuch::closeDatabase();
 }
 
 void Ner::run()
@@ -61,11 +75,32 @@ void Ner::run()
 
     _viewManager.refresh();
 
+    if (StartupTrace::enabled())
+        StartupTrace::instance().record("first frame");
+
+    auto frameTime = std::chrono::steady_clock::now();
+
     while (_running)
     {
-        int key = getch();
+        /* Don't let a stream of keys hold up timers and background work */
+        _eventLoop.dispatch();
+
+        int key = NCurses::readKey();
+        auto keyTime = std::chrono::steady_clock::now();
+
+        /* Whether there was no key, only something to show */
+        bool woken = key == ERR && _eventLoop.woken();
+
+        /* Pick up tag changes written in the background, and, when idle,
+         * changes made by other programs */
+        if (key == ERR && !woken)
+            Notmuch::checkForChanges();
 
-        if (key == KEY_BACKSPACE && sequence.size() > 0)
+        Notmuch::refreshDatabase();
+
+        if (woken)
+            _statusBar.update();
+        else if (key == KEY_BACKSPACE && sequence.size() > 0)
             sequence.pop_back();
         else if (key == 'c' - 96) // Ctrl-C
             sequence.clear();
@@ -95,8 +130,25 @@ void Ner::run()
         if (!_running)
             break;
 
+        /* Nothing changes on the screen until a key sequence is complete */
+        if (!sequence.empty())
+            continue;
+
+        /* Let a burst of keys, such as a held down j, catch up first */
+        if (NCurses::inputPending() && std::chrono::steady_clock::now() - frameTime < frameInterval)
+            continue;
+
         _viewManager.update();
         _viewManager.refresh();
+
+        frameTime = std::chrono::steady_clock::now();
+
+        if (LatencyRecorder::enabled() && !woken)
+        {
+            LatencyRecorder::instance().record(_viewManager.activeView().name(),
+                LatencyRecorder::Event::KeyToPaint, std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - keyTime));
+        }
     }
 }
 
@@ -174,11 +226,10 @@ void Ner::openViewView()
 
 void Ner::redraw()
 {
-    clear();
-    refresh();
+    /* Repaint the whole terminal with the next frame */
+    clearok(curscr, TRUE);
 
     _statusBar.update();
-    _statusBar.refresh();
 }
 
 // vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
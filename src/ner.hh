@@ -24,8 +24,12 @@
 #include <vector>
 
 #include "input_handler.hh"
+#include "event_loop.hh"
+#include "database_pool.hh"
 #include "view_manager.hh"
 #include "status_bar.hh"
+#include "tag_writer.hh"
+#include "message_prefetcher.hh"
 
 class Ner : public InputHandler
 {
@@ -50,8 +54,17 @@ class Ner : public InputHandler
 
     private:
         bool _running;
+
+        /* First, so everything else can use it while being set up */
+        EventLoop _eventLoop;
+
+        /* Before the views and the TagWriter, which check out handles */
+        DatabasePool _databasePool;
+
         ViewManager _viewManager;
         StatusBar _statusBar;
+        TagWriter _tagWriter;
+        MessagePrefetcher _messagePrefetcher;
 };
 
 #endif
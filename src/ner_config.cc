@@ -87,6 +87,9 @@ void NerConfig::load()
     _sortMode = NOTMUCH_SORT_NEWEST_FIRST;
     _refreshView = true;
     _addSigDashes = true;
+    _messageCacheSize = 64 << 20;
+    _htmlTimeout = 5000;
+    _htmlWorkers = 2;
     _commands.clear();
 
     std::map<ColorID, Color> colorMap = defaultColorMap;
@@ -129,6 +132,19 @@ void NerConfig::load()
             auto addSigDashesNode = general["add_sig_dashes"];
             if (addSigDashesNode.IsDefined())
                 _addSigDashes = addSigDashesNode.as<bool>();
+
+            /* In megabytes */
+            auto messageCacheSizeNode = general["message_cache_size"];
+            if (messageCacheSizeNode.IsDefined())
+                _messageCacheSize = messageCacheSizeNode.as<size_t>() << 20;
+
+            auto htmlTimeoutNode = general["html_timeout"];
+            if (htmlTimeoutNode.IsDefined())
+                _htmlTimeout = htmlTimeoutNode.as<int>();
+
+            auto htmlWorkersNode = general["html_workers"];
+            if (htmlWorkersNode.IsDefined())
+                _htmlWorkers = std::max(1u, htmlWorkersNode.as<unsigned>());
         }
 
         /* Commands */
@@ -228,6 +244,8 @@ std::string NerConfig::command(const std::string & name)
     {
         return command->second;
     }
+
+    return std::string();
 }
 
 const std::vector<Search> & NerConfig::searches() const
@@ -250,5 +268,20 @@ bool NerConfig::addSigDashes() const
     return _addSigDashes;
 }
 
+size_t NerConfig::messageCacheSize() const
+{
+    return _messageCacheSize;
+}
+
+int NerConfig::htmlTimeout() const
+{
+    return _htmlTimeout;
+}
+
+unsigned NerConfig::htmlWorkers() const
+{
+    return _htmlWorkers;
+}
+
 // vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
 
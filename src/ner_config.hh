@@ -43,6 +43,21 @@ class NerConfig
 
         bool addSigDashes() const;
 
+        /**
+         * The memory budget of the parsed message cache, in bytes.
+         */
+        size_t messageCacheSize() const;
+
+        /**
+         * How long to wait for an HTML conversion, in milliseconds.
+         */
+        int htmlTimeout() const;
+
+        /**
+         * The number of html_server converters to keep running.
+         */
+        unsigned htmlWorkers() const;
+
     private:
         NerConfig();
         ~NerConfig();
@@ -52,6 +67,9 @@ class NerConfig
         notmuch_sort_t _sortMode;
         bool _refreshView;
         bool _addSigDashes;
+        size_t _messageCacheSize;
+        int _htmlTimeout;
+        unsigned _htmlWorkers;
 };
 
 #endif
@@ -18,16 +18,95 @@
  */
 
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <future>
+#include <chrono>
 #include <glib-object.h>
 
 #include "notmuch.hh"
+#include "tag_writer.hh"
+#include "database_pool.hh"
+#include "event_loop.hh"
+#include "startup_trace.hh"
+#include "util.hh"
 
 GKeyFile * _config = NULL;
-notmuch_database_t * _notmuchDatabase = NULL;
+
+/* The read-only database used by the user interface. Tag changes are written
+ * by the TagWriter through its own read-write handle. Objects handed out with
+ * own() hold a reference, so a replaced handle lives until they are gone. */
+std::shared_ptr<notmuch_database_t> _notmuchDatabase;
+std::atomic<bool> _databaseModified(false);
+
+/* The user interface database while it is being opened in the background */
+std::future<notmuch_database_t *> _openingDatabase;
+
+/**
+ * Installs the user interface database once it has been opened.
+ *
+ * \param wait Whether to wait for it to finish opening.
+ * \return Whether it has been installed.
+ */
+static bool finishOpening(bool wait)
+{
+    if (!_openingDatabase.valid())
+        return true;
+
+    if (!wait && _openingDatabase.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+
+    _notmuchDatabase.reset(_openingDatabase.get(), notmuch_database_destroy);
+
+    return true;
+}
+
+static notmuch_database_t * currentDatabase()
+{
+    finishOpening(true);
+
+    return _notmuchDatabase.get();
+}
 
 notmuch_database_t * Notmuch::openDatabase(notmuch_database_mode_t mode)
 {
-    return _notmuchDatabase;
+    char * db = g_key_file_get_string(_config, "database", "path", NULL);
+
+    notmuch_database_t * ret;
+    notmuch_status_t s = notmuch_database_open(db, mode, &ret);
+    if (s != NOTMUCH_STATUS_SUCCESS) {
+        throw std::runtime_error("Open database failed: "+std::string(notmuch_status_to_string(s)));
+    }
+
+    return ret;
+}
+
+notmuch_database_t * Notmuch::database()
+{
+    return currentDatabase();
+}
+
+std::shared_ptr<void> Notmuch::own(notmuch_query_t * query)
+{
+    finishOpening(true);
+
+    std::shared_ptr<notmuch_database_t> database(_notmuchDatabase);
+
+    return std::shared_ptr<void>(query, [database](void * query) {
+        notmuch_query_destroy(static_cast<notmuch_query_t *>(query));
+    });
+}
+
+std::shared_ptr<void> Notmuch::own(notmuch_message_t * message)
+{
+    finishOpening(true);
+
+    std::shared_ptr<notmuch_database_t> database(_notmuchDatabase);
+
+    return std::shared_ptr<void>(message, [database](void * message) {
+        notmuch_message_destroy(static_cast<notmuch_message_t *>(message));
+    });
 }
 
 GKeyFile * Notmuch::config()
@@ -35,35 +114,95 @@ GKeyFile * Notmuch::config()
     return _config;
 }
 
-void Notmuch::initializeDatabase(const std::string & path)
+void Notmuch::loadConfig(const std::string & path)
 {
     _config = g_key_file_new();
     if (!g_key_file_load_from_file(_config, path.c_str(), G_KEY_FILE_NONE, NULL))
         throw new std::string("Couldn't load config file");
+}
 
-    char * db = g_key_file_get_string(_config, "database", "path", NULL);
-    notmuch_status_t s = notmuch_database_open(db, NOTMUCH_DATABASE_MODE_READ_WRITE, &_notmuchDatabase);
-    if (s != NOTMUCH_STATUS_SUCCESS) {
-        throw std::runtime_error("Open database failed: "+std::string(notmuch_status_to_string(s)));
-    }
+void Notmuch::initializeDatabase()
+{
+    /* On a cold cache, opening the database can take seconds, so the first
+     * screen is drawn while it opens */
+    _openingDatabase = std::async(std::launch::async, [] {
+        auto start = std::chrono::steady_clock::now();
+        auto wake = onScopeEnd([] { EventLoop::instance().wake(); });
+
+        notmuch_database_t * database = openDatabase(NOTMUCH_DATABASE_MODE_READ_ONLY);
+
+        if (StartupTrace::enabled())
+            StartupTrace::instance().record("open database", start);
+
+        return database;
+    });
 }
 
-notmuch_database_t * Notmuch::readonlyDatabase()
+bool Notmuch::databaseLoaded()
 {
-    char * db = g_key_file_get_string(_config, "database", "path", NULL);
+    return finishOpening(false);
+}
 
-    notmuch_database_t * ret;
-    notmuch_status_t s = notmuch_database_open(db, NOTMUCH_DATABASE_MODE_READ_ONLY, &ret);
-    if (s != NOTMUCH_STATUS_SUCCESS) {
-        throw std::runtime_error("Open database failed: "+std::string(notmuch_status_to_string(s)));
+void Notmuch::invalidateDatabase()
+{
+    _databaseModified = true;
+    DatabasePool::instance().invalidate();
+}
+
+void Notmuch::refreshDatabase()
+{
+    /* If it is still being opened, it is reopened once it has been */
+    if (!finishOpening(false))
+        return;
+
+    if (_databaseModified.exchange(false))
+    {
+        _notmuchDatabase.reset(openDatabase(NOTMUCH_DATABASE_MODE_READ_ONLY), notmuch_database_destroy);
     }
+}
 
-    return ret;
+void Notmuch::checkForChanges()
+{
+    /* There is nothing to compare with yet */
+    if (!finishOpening(false))
+        return;
+
+    notmuch_database_t * database = openDatabase(NOTMUCH_DATABASE_MODE_READ_ONLY);
+
+    const char * uuid;
+    unsigned long revision = notmuch_database_get_revision(database, &uuid);
+    std::string latestUuid(uuid);
+
+    notmuch_database_destroy(database);
+
+    unsigned long currentRevision = notmuch_database_get_revision(_notmuchDatabase.get(), &uuid);
+
+    if (revision != currentRevision || latestUuid != uuid)
+        invalidateDatabase();
+}
+
+unsigned long Notmuch::databaseRevision()
+{
+    const char * uuid;
+
+    return notmuch_database_get_revision(currentDatabase(), &uuid);
 }
 
 void Notmuch::closeDatabase()
 {
-    notmuch_database_close(_notmuchDatabase);
+    /* Let it finish opening, so that it can be closed */
+    if (_openingDatabase.valid())
+    {
+        try
+        {
+            finishOpening(true);
+        }
+        catch (const std::exception & e)
+        {
+        }
+    }
+
+    _notmuchDatabase.reset();
 }
 
 
@@ -71,7 +210,7 @@ unsigned Notmuch::countMessages(std::string query)
 {
     unsigned ret;
 
-    notmuch_query_t * x = notmuch_query_create(_notmuchDatabase,query.c_str());
+    notmuch_query_t * x = notmuch_query_create(currentDatabase(),query.c_str());
     ret = notmuch_query_count_messages(x);
     notmuch_query_destroy(x);
 
@@ -84,8 +223,8 @@ std::vector<Thread> & Notmuch::searchThreads(std::string query)
 
 notmuch_thread_t * Notmuch::thread(std::string id, notmuch_query_t ** queryp)
 {
-    const char * queryString = ("thread:" + id).c_str();
-    notmuch_query_t * query = notmuch_query_create(_notmuchDatabase, queryString);
+    std::string queryString("thread:" + id);
+    notmuch_query_t * query = notmuch_query_create(currentDatabase(), queryString.c_str());
     notmuch_threads_t * threads = notmuch_query_search_threads(query);
 
     notmuch_thread_t * thread = NULL;
@@ -98,21 +237,10 @@ notmuch_thread_t * Notmuch::thread(std::string id, notmuch_query_t ** queryp)
     throw InvalidThreadException(id);
 }
 
-Thread & Notmuch::getThread(std::string id)
-{
-    notmuch_query_t * query = NULL;
-    notmuch_thread_t * thread = Notmuch::thread(id, &query);
-
-    Thread & ret = *(new Thread(thread));
-    notmuch_query_destroy(query);
-
-    return ret;
-}
-
 notmuch_message_t * Notmuch::message(std::string id)
 {
     notmuch_message_t * message = NULL;
-    notmuch_database_find_message(_notmuchDatabase, id.c_str(), &message);
+    notmuch_database_find_message(currentDatabase(), id.c_str(), &message);
 
     if (message == NULL)
         throw InvalidMessageException(id);
@@ -120,7 +248,110 @@ notmuch_message_t * Notmuch::message(std::string id)
     return message;
 }
 
-Message & Notmuch::getMessage(std::string id)
+Message Notmuch::getMessage(std::string id)
+{
+    notmuch_message_t * message = Notmuch::message(id);
+
+    return Message(message, own(message));
+}
+
+void Notmuch::TagBatch::addTag(const std::string & tag)
+{
+    _removedTags.erase(std::remove(_removedTags.begin(), _removedTags.end(), tag),
+        _removedTags.end());
+    _addedTags.push_back(tag);
+}
+
+void Notmuch::TagBatch::removeTag(const std::string & tag)
+{
+    _addedTags.erase(std::remove(_addedTags.begin(), _addedTags.end(), tag),
+        _addedTags.end());
+    _removedTags.push_back(tag);
+}
+
+void Notmuch::TagBatch::addThread(const std::string & id)
 {
-    return *(new Message(Notmuch::message(id)));
+    _threadIds.push_back(id);
+}
+
+void Notmuch::TagBatch::addMessage(const std::string & id)
+{
+    _messageIds.push_back(id);
+}
+
+bool Notmuch::TagBatch::empty() const
+{
+    return (_addedTags.empty() && _removedTags.empty()) ||
+        (_threadIds.empty() && _messageIds.empty());
+}
+
+void Notmuch::TagBatch::commit()
+{
+    if (!empty())
+        TagWriter::instance().enqueue(*this);
+}
+
+Notmuch::TagBatch::Result Notmuch::TagBatch::apply(notmuch_database_t * database) const
+{
+    Result result = { NOTMUCH_STATUS_SUCCESS, 0 };
+
+    auto apply = [this, &result](notmuch_message_t * message) {
+        notmuch_status_t status = notmuch_message_freeze(message);
+
+        for (auto tag = _addedTags.begin(), e = _addedTags.end();
+            tag != e && status == NOTMUCH_STATUS_SUCCESS; ++tag)
+        {
+            status = notmuch_message_add_tag(message, tag->c_str());
+        }
+
+        for (auto tag = _removedTags.begin(), e = _removedTags.end();
+            tag != e && status == NOTMUCH_STATUS_SUCCESS; ++tag)
+        {
+            status = notmuch_message_remove_tag(message, tag->c_str());
+        }
+
+        notmuch_message_thaw(message);
+
+        if (status == NOTMUCH_STATUS_SUCCESS)
+            ++result.messages;
+        else if (result.status == NOTMUCH_STATUS_SUCCESS)
+            result.status = status;
+    };
+
+    /* Gather the messages of all the threads with a single query */
+    if (!_threadIds.empty())
+    {
+        std::string queryString;
+
+        for (auto id = _threadIds.begin(), e = _threadIds.end(); id != e; ++id)
+            queryString += (id == _threadIds.begin() ? "thread:" : " or thread:") + *id;
+
+        notmuch_query_t * query = notmuch_query_create(database, queryString.c_str());
+        notmuch_messages_t * messages;
+
+        for (messages = notmuch_query_search_messages(query);
+            notmuch_messages_valid(messages);
+            notmuch_messages_move_to_next(messages))
+        {
+            notmuch_message_t * message = notmuch_messages_get(messages);
+            apply(message);
+            notmuch_message_destroy(message);
+        }
+
+        notmuch_query_destroy(query);
+    }
+
+    for (auto id = _messageIds.begin(), e = _messageIds.end(); id != e; ++id)
+    {
+        notmuch_message_t * message = NULL;
+        notmuch_database_find_message(database, id->c_str(), &message);
+
+        if (message == NULL)
+            continue;
+
+        apply(message);
+        notmuch_message_destroy(message);
+    }
+
+    return result;
 }
@@ -24,30 +24,149 @@
 #include <vector>
 #include <stdexcept>
 #include <future>
+#include <memory>
 
 #include "thread.hh"
 
+class TagWriter;
+
 #include <notmuch.h>
 #include <glib.h>
 
 namespace Notmuch
 {
-    void initializeDatabase(const std::string & path);
-    notmuch_database_t * readonlyDatabase();
+    /**
+     * Loads the notmuch configuration file.
+     */
+    void loadConfig(const std::string & path);
+
+    /**
+     * Starts opening the user interface database in the background, waking
+     * the EventLoop once it is open.
+     *
+     * Until then, the functions which use it wait for it to be opened.
+     */
+    void initializeDatabase();
+
+    /**
+     * Whether the user interface database has been opened, so that using it
+     * will not wait.
+     *
+     * \throw std::runtime_error If the database could not be opened.
+     */
+    bool databaseLoaded();
+
     void closeDatabase();
 
+    /**
+     * Opens a new handle to the database.
+     */
     notmuch_database_t * openDatabase(notmuch_database_mode_t mode = NOTMUCH_DATABASE_MODE_READ_ONLY);
 
+    /**
+     * Returns the read-only database used by the user interface.
+     */
+    notmuch_database_t * database();
+
+    /**
+     * Marks the user interface database, and the handles in the
+     * DatabasePool, as out of date.
+     *
+     * This may be called from any thread.
+     */
+    void invalidateDatabase();
+
+    /**
+     * Reopens the user interface database if it has been invalidated.
+     *
+     * The old handle stays open until nothing obtained through own() uses it.
+     */
+    void refreshDatabase();
+
+    /**
+     * Invalidates the user interface database if another program has
+     * changed the database since it was opened.
+     */
+    void checkForChanges();
+
+    /**
+     * Returns the revision of the user interface database.
+     *
+     * This changes whenever the database is reopened with new changes, so it
+     * can be used to tell when cached results are out of date.
+     */
+    unsigned long databaseRevision();
+
+    /**
+     * Takes ownership of a query from the user interface database.
+     *
+     * \return A reference which destroys the query, and keeps its database
+     *         open, until the last copy is released.
+     */
+    std::shared_ptr<void> own(notmuch_query_t * query);
+
+    /**
+     * \overload
+     */
+    std::shared_ptr<void> own(notmuch_message_t * message);
+
     unsigned countMessages(std::string query);
     std::vector<Thread> & searchThreads(std::string query);
 
     notmuch_thread_t * thread(std::string id, notmuch_query_t ** queryp);
-    Thread & getThread(std::string id);
 
     notmuch_message_t * message(std::string id);
-    Message & getMessage(std::string id);
+    Message getMessage(std::string id);
 
     GKeyFile * config();
+
+    /**
+     * A set of tag changes applied to a number of threads and messages in a
+     * single atomic database transaction.
+     */
+    class TagBatch
+    {
+        public:
+            struct Result
+            {
+                notmuch_status_t status;
+                unsigned messages;
+            };
+
+            void addTag(const std::string & tag);
+            void removeTag(const std::string & tag);
+
+            /**
+             * Applies the tag changes to every message of the given thread.
+             */
+            void addThread(const std::string & id);
+            void addMessage(const std::string & id);
+
+            bool empty() const;
+
+            /**
+             * Queues the tag changes to be written by the TagWriter.
+             */
+            void commit();
+
+            /**
+             * Writes the tag changes to the given database.
+             *
+             * This should be called inside an atomic section.
+             *
+             * \return The status, and the number of messages changed.
+             */
+            Result apply(notmuch_database_t * database) const;
+
+        private:
+            std::vector<std::string> _addedTags;
+            std::vector<std::string> _removedTags;
+
+            std::vector<std::string> _threadIds;
+            std::vector<std::string> _messageIds;
+
+        friend class ::TagWriter;
+    };
 };
 
 #endif
@@ -30,9 +30,9 @@
 ReplyView::ReplyView(const std::string & messageId, const View::Geometry & geometry)
     : EmailEditView(geometry)
 {
-    Message & message = Notmuch::getMessage(messageId);
+    Message message = Notmuch::getMessage(messageId);
 
-    FILE * messageFile = fopen(message.filename.c_str(), "r");
+    FILE * messageFile = fopen(message.filename().c_str(), "r");
     GMimeStream * stream = g_mime_stream_file_new(messageFile);
     GMimeParser * parser = g_mime_parser_new_with_stream(stream);
 
@@ -148,8 +148,12 @@ ReplyView::ReplyView(const std::string & messageId, const View::Geometry & geome
     MessagePartTextVisitor<std::ostream_iterator<std::string>> visitor(
         std::ostream_iterator<std::string>(messageContentStream, "\n> "));
 
+    /* Quote the converted text of HTML parts, not the placeholder */
     for (auto messagePart = parts.begin(), e = parts.end(); messagePart != e; ++messagePart)
+    {
+        (*messagePart)->wait();
         (*messagePart)->accept(visitor);
+    }
 
     g_object_unref(part);
 
@@ -18,81 +18,130 @@
  */
 
 #include <sstream>
+#include <chrono>
+#include <algorithm>
 
 #include "search_list_view.hh"
 #include "view_manager.hh"
 #include "search_view.hh"
 #include "ncurses.hh"
 #include "ner_config.hh"
+#include "notmuch.hh"
+#include "event_loop.hh"
+#include "database_pool.hh"
+#include "startup_trace.hh"
+#include "status_bar.hh"
 
 const int searchNameWidth = 15;
 const int searchTermsWidth = 30;
 
 SearchListView::SearchListView(const View::Geometry & geometry)
     : LineBrowserView(geometry),
-        _searches(NerConfig::instance().searches())
+        _searches(NerConfig::instance().searches()),
+        _running(true),
+        _counts(_searches.size(), Count{ 0, 0, 0, false }),
+        _requestedRevision(0)
 {
+    _thread = std::thread(std::bind(&SearchListView::countMessages, this));
+
     /* Key Sequences */
     addHandledSequence("\n", std::bind(&SearchListView::openSelectedSearch, this));
 }
 
 SearchListView::~SearchListView()
 {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _condition.notify_one();
+    _thread.join();
 }
 
 void SearchListView::update()
 {
-    werase(_window);
+    /* Counting starts without waiting for the database to be opened */
+    unsigned long revision = Notmuch::databaseLoaded() ? Notmuch::databaseRevision() : 0;
 
-    if (_offset > _searches.size())
-        return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
 
-    int row = 0;
+        /* Recount when the database changes; the old counts are shown, as
+         * stale, until then */
+        if (revision > _requestedRevision)
+        {
+            _requestedRevision = revision;
+            _condition.notify_one();
 
-    for (auto search = _searches.begin();
-        search != _searches.end() && row < getmaxy(_window);
-        ++search, ++row)
-    {
-        bool selected = row + _offset == _selectedIndex;
+            invalidate();
+        }
 
-        int x = 0;
+        for (auto line = _countedLines.begin(), e = _countedLines.end(); line != e; ++line)
+            invalidateLine(*line);
 
-        wmove(_window, row, x);
+        _countedLines.clear();
+    }
 
-        attr_t attributes = 0;
+    updateLines();
+}
 
-        if (selected)
-            attributes |= A_REVERSE;
+void SearchListView::displayLine(int index)
+{
+    const Search & search = _searches[index];
 
-        wchgat(_window, -1, attributes, 0, NULL);
+    bool selected = index == _selectedIndex;
 
-        try
-        {
-            /* Search Name */
-            NCurses::addUtf8String(_window, search->name.c_str(), attributes,
-                ColorID::SearchListViewName, searchNameWidth - 1);
+    int x = 0;
 
-            NCurses::checkMove(_window, x += searchNameWidth);
+    wmove(_window, index - _offset, x);
 
-            /* Search Terms */
-            NCurses::addUtf8String(_window, search->query.c_str(), attributes,
-                ColorID::SearchListViewTerms, searchTermsWidth - 1);
+    attr_t attributes = 0;
 
-            NCurses::checkMove(_window, x += searchTermsWidth);
+    if (selected)
+        attributes |= A_REVERSE;
 
-            /* Number of Results */
-            std::ostringstream results;
-            results << Notmuch::countMessages(search->query) << " results";
+    wchgat(_window, -1, attributes, 0, NULL);
 
-            NCurses::addPlainString(_window, results.str(), attributes,
-                ColorID::SearchListViewResults);
+    try
+    {
+        /* Search Name */
+        NCurses::addUtf8String(_window, search.name.c_str(), attributes,
+            ColorID::SearchListViewName, searchNameWidth - 1);
+
+        NCurses::checkMove(_window, x += searchNameWidth);
+
+        /* Search Terms */
+        NCurses::addUtf8String(_window, search.query.c_str(), attributes,
+            ColorID::SearchListViewTerms, searchTermsWidth - 1);
+
+        NCurses::checkMove(_window, x += searchTermsWidth);
 
-            NCurses::checkMove(_window, x - 1);
+        /* Number of Results */
+        Count count;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            count = _counts[index];
+
+            if (count.revision < _requestedRevision)
+                attributes |= A_DIM;
         }
-        catch (const NCurses::CutOffException & e)
+
+        if (count.counted)
         {
-            NCurses::addCutOffIndicator(_window, attributes);
+            std::ostringstream results;
+            results << count.total << " results, " << count.unread << " unread";
+
+            NCurses::addPlainString(_window, results.str(), attributes,
+                ColorID::SearchListViewResults);
         }
+
+        NCurses::checkMove(_window, x - 1);
+    }
+    catch (const NCurses::CutOffException & e)
+    {
+        NCurses::addCutOffIndicator(_window, attributes);
     }
 }
 
@@ -114,6 +163,103 @@ int SearchListView::lineCount() const
     return _searches.size();
 }
 
+void SearchListView::countMessages()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    /* The revision the current counts were made at */
+    unsigned long countedRevision = 0;
+    bool counted = false;
+
+    while (true)
+    {
+        /* The counts may be made at a later revision than the user interface
+         * database has, such as before it has been opened, which needs no
+         * recount when it catches up */
+        while (_running && counted && countedRevision >= _requestedRevision)
+            _condition.wait(lock);
+
+        if (!_running)
+            break;
+
+        /* The revision asked for when this pass started */
+        unsigned long requestedRevision = _requestedRevision;
+
+        lock.unlock();
+
+        unsigned long revision = 0;
+        bool failed = false;
+
+        try
+        {
+            DatabasePool::Handle database = DatabasePool::instance().acquire();
+
+            const char * uuid;
+            revision = notmuch_database_get_revision(database.get(), &uuid);
+
+            /* A pooled handle may have been opened before the user interface
+             * database, without the pool having been invalidated since */
+            if (revision < requestedRevision)
+            {
+                database.reopen();
+                revision = notmuch_database_get_revision(database.get(), &uuid);
+            }
+
+            bool complete = true;
+
+            for (int index = 0; index < _searches.size(); ++index)
+            {
+                const std::string & query = _searches[index].query;
+                std::string unreadQuery("(" + query + ") and tag:unread");
+
+                notmuch_query_t * totalQuery = notmuch_query_create(database.get(), query.c_str());
+                unsigned total = notmuch_query_count_messages(totalQuery);
+                notmuch_query_destroy(totalQuery);
+
+                notmuch_query_t * unreadCountQuery = notmuch_query_create(database.get(), unreadQuery.c_str());
+                unsigned unread = notmuch_query_count_messages(unreadCountQuery);
+                notmuch_query_destroy(unreadCountQuery);
+
+                lock.lock();
+
+                _counts[index] = Count{ total, unread, revision, true };
+                _countedLines.push_back(index);
+
+                bool stop = !_running || _requestedRevision > std::max(revision, requestedRevision);
+
+                lock.unlock();
+
+                EventLoop::instance().wake();
+
+                /* Start over if the database changed again */
+                if (stop)
+                {
+                    complete = false;
+                    break;
+                }
+            }
+
+            if (complete && StartupTrace::enabled())
+                StartupTrace::instance().record("count searches", start);
+        }
+        catch (const std::exception & e)
+        {
+            StatusBar::instance().postMessage(std::string("Could not count messages: ") + e.what());
+            failed = true;
+        }
+
+        lock.lock();
+
+        /* After a failure, only try again once the database changes. Counts
+         * which are still behind after reopening are not retried either, so
+         * that they cannot be redone forever. */
+        countedRevision = failed ? _requestedRevision : std::max(revision, requestedRevision);
+        counted = true;
+    }
+}
+
 void SearchListView::openSelectedSearch()
 {
     ViewManager::instance().addView(std::make_shared<SearchView>(
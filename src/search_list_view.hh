@@ -21,6 +21,9 @@
 #define NER_SEARCH_LIST_VIEW_H 1
 
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "line_browser_view.hh"
 
@@ -44,9 +47,39 @@ class SearchListView : public LineBrowserView
 
     protected:
         virtual int lineCount() const;
+        virtual void displayLine(int index);
 
     private:
+        /**
+         * The number of messages matching a search.
+         */
+        struct Count
+        {
+            unsigned total;
+            unsigned unread;
+
+            /* The database revision the count was made at */
+            unsigned long revision;
+            bool counted;
+        };
+
+        /**
+         * Counts the messages matching each search in the background,
+         * whenever a new database revision is requested.
+         */
+        void countMessages();
+
         std::vector<Search> _searches;
+
+        std::thread _thread;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _running;
+
+        /* The following are protected by _mutex */
+        std::vector<Count> _counts;
+        std::vector<int> _countedLines;
+        unsigned long _requestedRevision;
 };
 
 #endif
@@ -0,0 +1,364 @@
+/* ner: src/search_snapshot.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+#include "search_snapshot.hh"
+
+/* Increase when the layout below changes */
+const uint32_t snapshotVersion = 1;
+const char snapshotMagic[8] = { 'N', 'E', 'R', 'S', 'N', 'A', 'P', '\0' };
+
+/*
+ * The file starts with a Header, followed by, each aligned to 8 bytes:
+ *
+ *  - the database UUID and the search terms,
+ *  - indexCount Entry records,
+ *  - summaryCount Summary records,
+ *  - tagCount string indices, referred to by the summaries,
+ *  - stringCount + 1 offsets into the string data, then the string data.
+ *
+ * Numbers are in the native byte order; snapshots are not meant to be shared
+ * between machines.
+ */
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sortMode;
+    uint64_t revision;
+    uint32_t uuidLength;
+    uint32_t searchTermsLength;
+    uint64_t indexCount;
+    uint32_t summaryCount;
+    uint32_t tagCount;
+    uint32_t stringCount;
+    uint32_t stringBytes;
+};
+
+struct Summary
+{
+    uint64_t id;
+    int64_t newestDate;
+    int64_t oldestDate;
+    uint32_t totalMessages;
+    uint32_t matchedMessages;
+    uint32_t subject;
+    uint32_t authors;
+    uint32_t firstTag;
+    uint32_t tagCount;
+};
+
+static size_t padded(size_t size)
+{
+    return (size + 7) & ~size_t(7);
+}
+
+/* FNV-1a, which unlike std::hash is stable between builds */
+static uint64_t hashString(const std::string & string)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (auto c = string.begin(), e = string.end(); c != e; ++c)
+    {
+        hash ^= static_cast<unsigned char>(*c);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static void writePadded(std::ostream & stream, const void * data, size_t size)
+{
+    const char padding[8] = {};
+
+    stream.write(static_cast<const char *>(data), size);
+    stream.write(padding, padded(size) - size);
+}
+
+/**
+ * Assigns each distinct string an index into the string table.
+ */
+class StringTable
+{
+    public:
+        uint32_t intern(const std::string & string)
+        {
+            auto inserted = _indices.insert(std::make_pair(string, _offsets.size()));
+
+            if (inserted.second)
+            {
+                _offsets.push_back(_data.size());
+                _data.append(string);
+            }
+
+            return inserted.first->second;
+        }
+
+        void write(std::ostream & stream) const
+        {
+            std::vector<uint32_t> offsets(_offsets);
+            offsets.push_back(_data.size());
+
+            writePadded(stream, offsets.data(), offsets.size() * sizeof(uint32_t));
+            stream.write(_data.data(), _data.size());
+        }
+
+        uint32_t count() const
+        {
+            return _offsets.size();
+        }
+
+        uint32_t bytes() const
+        {
+            return _data.size();
+        }
+
+    private:
+        std::unordered_map<std::string, uint32_t> _indices;
+        std::vector<uint32_t> _offsets;
+        std::string _data;
+};
+
+/**
+ * Reads consecutive, bounds checked arrays out of a mapped snapshot.
+ */
+class Reader
+{
+    public:
+        Reader(const char * data, size_t size)
+            : _data(data), _size(size), _position(0)
+        {
+        }
+
+        template <typename T>
+            const T * read(size_t count)
+        {
+            size_t bytes = count * sizeof(T);
+
+            if (count > _size / sizeof(T) || _position > _size - bytes)
+                return NULL;
+
+            const T * array = reinterpret_cast<const T *>(_data + _position);
+            _position = std::min(padded(_position + bytes), _size);
+
+            return array;
+        }
+
+    private:
+        const char * _data;
+        size_t _size;
+        size_t _position;
+};
+
+SearchSnapshot::SearchSnapshot(const std::string & searchTerms, notmuch_sort_t sortMode)
+    : revision(0), _searchTerms(searchTerms), _sortMode(sortMode)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016" PRIx64 ".snapshot", hashString(searchTerms));
+
+    char * path = g_build_filename(g_get_user_cache_dir(), "ner", "searches", name, NULL);
+    _path = path;
+    g_free(path);
+}
+
+bool SearchSnapshot::load()
+{
+    int fd = open(_path.c_str(), O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    struct stat status;
+
+    if (fstat(fd, &status) == -1 || status.st_size < static_cast<off_t>(sizeof(Header)))
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = status.st_size;
+    void * mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+        return false;
+
+    Reader reader(static_cast<const char *>(mapping), size);
+
+    bool valid = false;
+    const Header * header = reader.read<Header>(1);
+
+    if (header && std::memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) == 0 &&
+        header->version == snapshotVersion && header->sortMode == static_cast<uint32_t>(_sortMode))
+    {
+        const char * uuidData = reader.read<char>(header->uuidLength);
+        const char * searchTerms = reader.read<char>(header->searchTermsLength);
+        const Entry * entries = reader.read<Entry>(header->indexCount);
+        const Summary * summaries = reader.read<Summary>(header->summaryCount);
+        const uint32_t * tags = reader.read<uint32_t>(header->tagCount);
+        const uint32_t * offsets = reader.read<uint32_t>(uint64_t(header->stringCount) + 1);
+        const char * stringData = reader.read<char>(header->stringBytes);
+
+        valid = uuidData && searchTerms && entries && summaries && tags && offsets && stringData &&
+            std::string(searchTerms, header->searchTermsLength) == _searchTerms;
+
+        auto string = [&](uint32_t index) {
+            if (index >= header->stringCount || offsets[index] > offsets[index + 1] ||
+                offsets[index + 1] > header->stringBytes)
+            {
+                valid = false;
+                return std::string();
+            }
+
+            return std::string(stringData + offsets[index], offsets[index + 1] - offsets[index]);
+        };
+
+        if (valid)
+        {
+            uuid.assign(uuidData, header->uuidLength);
+            revision = header->revision;
+            index.assign(entries, entries + header->indexCount);
+
+            threads.clear();
+            threads.reserve(header->summaryCount);
+            strings.clear();
+
+            char id[17];
+
+            for (uint32_t i = 0; i < header->summaryCount && valid; ++i)
+            {
+                const Summary & summary = summaries[i];
+
+                std::snprintf(id, sizeof(id), "%016" PRIx64, summary.id);
+
+                Thread thread(id, strings);
+                thread.subject = strings.add(string(summary.subject));
+                thread.authors = strings.add(string(summary.authors));
+                thread.totalMessages = summary.totalMessages;
+                thread.matchedMessages = summary.matchedMessages;
+                thread.newestDate = summary.newestDate;
+                thread.oldestDate = summary.oldestDate;
+
+                if (summary.firstTag > header->tagCount ||
+                    summary.tagCount > header->tagCount - summary.firstTag)
+                {
+                    valid = false;
+                    break;
+                }
+
+                for (uint32_t tag = 0; tag < summary.tagCount; ++tag)
+                    thread.tags.insert(string(tags[summary.firstTag + tag]));
+
+                threads.push_back(std::move(thread));
+            }
+        }
+    }
+
+    munmap(mapping, size);
+
+    if (!valid)
+    {
+        index.clear();
+        threads.clear();
+    }
+
+    return valid;
+}
+
+void SearchSnapshot::save() const
+{
+    char * directory = g_path_get_dirname(_path.c_str());
+    int made = g_mkdir_with_parents(directory, 0700);
+    g_free(directory);
+
+    if (made != 0)
+        return;
+
+    StringTable stringTable;
+    std::vector<Summary> summaries;
+    std::vector<uint32_t> tags;
+
+    summaries.reserve(threads.size());
+
+    for (auto thread = threads.begin(), e = threads.end(); thread != e; ++thread)
+    {
+        Summary summary;
+        summary.id = std::strtoull(thread->id, NULL, 16);
+        summary.newestDate = thread->newestDate;
+        summary.oldestDate = thread->oldestDate;
+        summary.totalMessages = thread->totalMessages;
+        summary.matchedMessages = thread->matchedMessages;
+        summary.subject = stringTable.intern(thread->subject);
+        summary.authors = stringTable.intern(thread->authors);
+        summary.firstTag = tags.size();
+        summary.tagCount = thread->tags.size();
+
+        std::vector<TagSet::Tag> threadTags(thread->tags.sorted());
+
+        for (auto tag = threadTags.begin(), e = threadTags.end(); tag != e; ++tag)
+            tags.push_back(stringTable.intern(TagSet::name(*tag)));
+
+        summaries.push_back(summary);
+    }
+
+    Header header;
+    std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.sortMode = _sortMode;
+    header.revision = revision;
+    header.uuidLength = uuid.size();
+    header.searchTermsLength = _searchTerms.size();
+    header.indexCount = index.size();
+    header.summaryCount = summaries.size();
+    header.tagCount = tags.size();
+    header.stringCount = stringTable.count();
+    header.stringBytes = stringTable.bytes();
+
+    std::ostringstream stream;
+
+    writePadded(stream, &header, sizeof(header));
+    writePadded(stream, uuid.data(), uuid.size());
+    writePadded(stream, _searchTerms.data(), _searchTerms.size());
+    writePadded(stream, index.data(), index.size() * sizeof(Entry));
+    writePadded(stream, summaries.data(), summaries.size() * sizeof(Summary));
+    writePadded(stream, tags.data(), tags.size() * sizeof(uint32_t));
+    stringTable.write(stream);
+
+    std::string data(stream.str());
+
+    /* This writes to a uniquely named temporary file and renames it, so that
+     * a reader never sees half a snapshot, and views saving the same search
+     * at once don't write over each other's temporary files */
+    g_file_set_contents(_path.c_str(), data.data(), data.size(), NULL);
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -0,0 +1,85 @@
+/* ner: src/search_snapshot.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_SEARCH_SNAPSHOT_H
+#define NER_SEARCH_SNAPSHOT_H 1
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <notmuch.h>
+
+#include "thread.hh"
+
+/**
+ * The results of a search, saved in the user's cache directory so that they
+ * can be shown straight away the next time the search is opened.
+ *
+ * A snapshot holds the ID and date of every matching thread, and the
+ * summaries of the first few threads, stamped with the database revision
+ * they were collected at. The authors, subjects and tags of the summaries
+ * are interned in a string table, and the file is memory-mapped to load it.
+ */
+class SearchSnapshot
+{
+    public:
+        struct Entry
+        {
+            uint64_t id;
+            int64_t date;
+        };
+
+        SearchSnapshot(const std::string & searchTerms, notmuch_sort_t sortMode);
+
+        /**
+         * Reads the snapshot of the search, if there is one.
+         *
+         * \return Whether a valid snapshot was read.
+         */
+        bool load();
+
+        /**
+         * Writes the snapshot, replacing any earlier one. Failures are
+         * ignored, since the snapshot is only a cache.
+         */
+        void save() const;
+
+        /* The database the results were collected from */
+        std::string uuid;
+        unsigned long revision;
+
+        /* Every matching thread, in order */
+        std::vector<Entry> index;
+
+        /* Summaries of the threads at the start of the index */
+        std::vector<Thread> threads;
+
+        /* Holds the strings of the summaries read by load */
+        StringArena strings;
+
+    private:
+        std::string _searchTerms;
+        notmuch_sort_t _sortMode;
+        std::string _path;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
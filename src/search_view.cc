@@ -22,7 +22,10 @@
 #include <algorithm>
 #include <chrono>
 #include <iterator>
-#include <sched.h>
+#include <unordered_set>
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
 
 #include "search_view.hh"
 #include "thread_message_view.hh"
@@ -32,23 +35,89 @@
 #include "ncurses.hh"
 #include "notmuch.hh"
 #include "status_bar.hh"
+#include "tag_writer.hh"
 #include "line_editor.hh"
+#include "event_loop.hh"
+#include "database_pool.hh"
+#include "search_snapshot.hh"
 
 const int newestDateWidth = 13;
 const int messageCountWidth = 8;
 const int authorsWidth = 20;
 
+/* Number of thread summaries materialized at a time */
+const int threadPageSize = 64;
+
+/* Number of index entries collected before they are handed to the view */
+const int indexBatchSize = 256;
+
+/* Number of pages of thread summaries saved in snapshots */
+const int snapshotPages = 2;
+
 const auto conditionWaitTime = std::chrono::milliseconds(50);
 
+const TagSet::Tag unreadTag = TagSet::intern("unread");
+
+/* notmuch thread IDs are 16 hexadecimal digits, so they fit in an integer. */
+static uint64_t parseThreadId(const char * id)
+{
+    return std::strtoull(id, NULL, 16);
+}
+
+static std::string formatThreadId(uint64_t id)
+{
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016" PRIx64, id);
+    return buffer;
+}
+
+static bool dateSorted(notmuch_sort_t sortMode)
+{
+    return sortMode == NOTMUCH_SORT_NEWEST_FIRST || sortMode == NOTMUCH_SORT_OLDEST_FIRST;
+}
+
+std::function<bool (const SearchView::IndexEntry &, const SearchView::IndexEntry &)>
+    SearchView::indexOrder(notmuch_sort_t sortMode)
+{
+    return [sortMode](const IndexEntry & a, const IndexEntry & b) {
+        return sortMode == NOTMUCH_SORT_NEWEST_FIRST ? a.date > b.date : a.date < b.date;
+    };
+}
+
 SearchView::SearchView(const std::string & search, const View::Geometry & geometry)
     : LineBrowserView(geometry),
-        _searchTerms(search)
+        _searchTerms(search),
+        _snapshotOutdated(false),
+        _savingSnapshot(false),
+        _reconcileFailed(false)
 {
+    const std::vector<Search> & searches = NerConfig::instance().searches();
+
+    /* Only saved searches are snapshotted, so that one-off searches do not
+     * fill up the cache */
+    _snapshotted = dateSorted(NerConfig::instance().sortMode()) &&
+        std::any_of(searches.begin(), searches.end(),
+            [&search](const Search & saved) { return saved.query == search; });
+
+    bool fromSnapshot = _snapshotted && loadSnapshot();
+
     _collecting = true;
-    _thread = std::thread(std::bind(&SearchView::collectThreads, this));
+
+    if (fromSnapshot)
+        _thread = std::thread(std::bind(&SearchView::reconcileThreads, this));
+    else
+        _thread = std::thread([this] { collectThreads(); });
 
     /* Key Sequences */
-    addHandledSequence("=", std::bind(&SearchView::refreshThreads, this));
+    addHandledSequence("=", [this] {
+        /* Pick up changes made by other programs since the last check */
+        Notmuch::checkForChanges();
+        refreshThreads();
+    });
+    addHandledSequence("<Timeout>", [this] {
+        if (!_collecting)
+            refreshThreads();
+    });
     addHandledSequence("\n", std::bind(&SearchView::openSelectedThread, this));
 
     addHandledSequence("a", std::bind(&SearchView::archiveSelectedThread, this));
@@ -59,8 +128,11 @@ SearchView::SearchView(const std::string & search, const View::Geometry & geomet
     addHandledSequence("<C-t>",      std::bind(&SearchView::markToggle, this));
     addHandledSequence("<C-r>",      std::bind(&SearchView::clearMarks, this));
 
+    if (fromSnapshot)
+        return;
+
     std::unique_lock<std::mutex> lock(_mutex);
-    while (_threads.size() < getmaxy(_window) && _collecting)
+    while (_index.size() < getmaxy(_window) && _collecting)
         _condition.wait_for(lock, conditionWaitTime);
 }
 
@@ -71,103 +143,135 @@ SearchView::~SearchView()
         _collecting = false;
         _thread.join();
     }
+
+    if (_snapshotThread.joinable())
+        _snapshotThread.join();
 }
 
 void SearchView::update()
 {
-    werase(_window);
+    std::unique_ptr<Update> reconciliation;
+    bool reconcileFailed;
 
-    if (_offset > _threads.size())
-        return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
 
-    int row = 0;
+        reconciliation = std::move(_reconciliation);
+        reconcileFailed = _reconcileFailed;
+        _reconcileFailed = false;
+    }
 
-    for (auto thread = _threads.begin() + _offset;
-        thread != _threads.end() && row < getmaxy(_window);
-        ++thread, ++row)
+    /* Bring the results shown from the snapshot up to date */
+    if (reconciliation)
     {
-        bool selected = row + _offset == _selectedIndex;
-        bool unread = thread->tags.find("unread") != thread->tags.end();
-        bool completeMatch = thread->matchedMessages == thread->totalMessages;
+        _thread.join();
+        _collecting = false;
 
-        int x = 0;
+        applyUpdate(*reconciliation);
 
-        wmove(_window, row, x);
+        invalidate();
+        makeSelectionVisible();
+    }
+    else if (reconcileFailed)
+    {
+        /* The rows on screen show the snapshot's threads, which the new index
+         * no longer maps them to */
+        invalidate();
+        reloadThreads();
+    }
 
-        attr_t attributes = 0;
+    bool save;
 
-        if (unread)
-            attributes |= A_BOLD;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        save = _snapshotted && _snapshotOutdated && !_collecting && !_savingSnapshot;
+    }
 
-        if (selected)
-            attributes |= A_REVERSE;
+    if (save)
+        saveSnapshot();
 
-        wchgat(_window, -1, attributes, 0, NULL);
+    evictPages();
+    updateLines();
+}
 
-        try
-        {
-            /* Date */
-            NCurses::addPlainString(_window, relativeTime(thread->newestDate),
-                attributes, ColorID::SearchViewDate, newestDateWidth - 1);
+void SearchView::displayLine(int index)
+{
+    const Thread * thread = &this->thread(index);
 
-            NCurses::checkMove(_window, x += newestDateWidth);
+    bool selected = index == _selectedIndex;
+    bool unread = thread->tags.contains(unreadTag);
+    bool completeMatch = thread->matchedMessages == thread->totalMessages;
 
-            /* Message Count */
-            std::ostringstream messageCountStream;
-            messageCountStream << thread->matchedMessages << '/' << thread->totalMessages;
+    int x = 0;
 
-            x += NCurses::addChar(_window, '[', attributes);
-            NCurses::checkMove(_window, x);
+    wmove(_window, index - _offset, x);
 
-            x += NCurses::addPlainString(_window, messageCountStream.str(),
-                attributes, completeMatch ? ColorID::SearchViewMessageCountComplete :
-                                            ColorID::SearchViewMessageCountPartial,
-                messageCountWidth - 1);
-            NCurses::checkMove(_window, x);
+    attr_t attributes = 0;
 
-            NCurses::addChar(_window, ']', attributes);
+    if (unread)
+        attributes |= A_BOLD;
 
-            NCurses::checkMove(_window, x = newestDateWidth + messageCountWidth);
+    if (selected)
+        attributes |= A_REVERSE;
 
-            /* Authors */
-            NCurses::addUtf8String(_window, thread->authors.c_str(),
-                attributes, ColorID::SearchViewAuthors, authorsWidth - 1);
+    wchgat(_window, -1, attributes, 0, NULL);
 
-            NCurses::checkMove(_window, x += authorsWidth);
+    try
+    {
+        /* Date */
+        NCurses::addPlainString(_window, relativeTime(thread->newestDate),
+            attributes, ColorID::SearchViewDate, newestDateWidth - 1);
 
-            /* Subject */
-            x += NCurses::addUtf8String(_window, thread->subject.c_str(),
-                attributes, ColorID::SearchViewSubject);
+        NCurses::checkMove(_window, x += newestDateWidth);
 
-            NCurses::checkMove(_window, ++x);
+        /* Message Count */
+        std::ostringstream messageCountStream;
+        messageCountStream << thread->matchedMessages << '/' << thread->totalMessages;
 
-            /* Tags */
-            std::ostringstream tagStream;
-            std::copy(thread->tags.begin(), thread->tags.end(),
-                std::ostream_iterator<std::string>(tagStream, " "));
-            std::string tags(tagStream.str());
+        x += NCurses::addChar(_window, '[', attributes);
+        NCurses::checkMove(_window, x);
 
-            if (tags.size() > 0)
-                /* Get rid of the trailing space */
-                tags.resize(tags.size() - 1);
+        x += NCurses::addPlainString(_window, messageCountStream.str(),
+            attributes, completeMatch ? ColorID::SearchViewMessageCountComplete :
+                                        ColorID::SearchViewMessageCountPartial,
+            messageCountWidth - 1);
+        NCurses::checkMove(_window, x);
 
-            x += NCurses::addPlainString(_window, tags, attributes, ColorID::SearchViewTags);
+        NCurses::addChar(_window, ']', attributes);
 
-            NCurses::checkMove(_window, x - 1);
-        }
-        catch (const NCurses::CutOffException & e)
-        {
-            NCurses::addCutOffIndicator(_window, attributes);
-        }
+        NCurses::checkMove(_window, x = newestDateWidth + messageCountWidth);
+
+        /* Authors */
+        NCurses::addCachedUtf8String(_window, thread->authors,
+            attributes, ColorID::SearchViewAuthors, authorsWidth - 1);
+
+        NCurses::checkMove(_window, x += authorsWidth);
+
+        /* Subject */
+        x += NCurses::addCachedUtf8String(_window, thread->subject,
+            attributes, ColorID::SearchViewSubject);
+
+        NCurses::checkMove(_window, ++x);
+
+        /* Tags */
+        x += NCurses::addPlainString(_window, thread->tags.toString(), attributes,
+            ColorID::SearchViewTags);
+
+        NCurses::checkMove(_window, x - 1);
+    }
+    catch (const NCurses::CutOffException & e)
+    {
+        NCurses::addCutOffIndicator(_window, attributes);
     }
 }
 
 std::vector<std::string> SearchView::status() const
 {
     std::ostringstream threadPosition;
+    int count = lineCount();
 
-    if (_threads.size() > 0)
-        threadPosition << "thread " << (_selectedIndex + 1) << " of " << _threads.size();
+    if (count > 0)
+        threadPosition << "thread " << (_selectedIndex + 1) << " of " << count;
     else
         threadPosition << "no matching threads";
 
@@ -179,14 +283,12 @@ std::vector<std::string> SearchView::status() const
 
 void SearchView::openSelectedThread()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    if (_selectedIndex < _threads.size())
+    if (_selectedIndex < lineCount())
     {
         try
         {
             ViewManager::instance().addView(std::make_shared<ThreadMessageView>(
-                _threads.at(_selectedIndex).id));
+                threadId(_selectedIndex)));
         }
         catch (const InvalidThreadException & e)
         {
@@ -201,16 +303,14 @@ void SearchView::openSelectedThread()
 
 void SearchView::archiveSelectedThread()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    if (_selectedIndex < _threads.size())
+    if (_selectedIndex < lineCount())
     {
         try
         {
-            _threads.at(_selectedIndex).removeTag("inbox");
+            thread(_selectedIndex).removeTag("inbox");
 
+            invalidateLine(_selectedIndex);
             next();
-            update();
         }
         catch (const InvalidThreadException & e)
         {
@@ -224,6 +324,23 @@ void SearchView::archiveSelectedThread()
 }
 
 void SearchView::refreshThreads()
+{
+    /* Make sure the results include our own tag changes */
+    TagWriter::instance().flush();
+
+    /* Redraw everything, if only to bring the relative dates up to date */
+    invalidate();
+
+    if (!_collecting && updateThreads())
+    {
+        StatusBar::instance().update();
+        makeSelectionVisible();
+    }
+    else
+        reloadThreads();
+}
+
+void SearchView::reloadThreads()
 {
     /* If the thread is still going, stop it, and wait for it to return */
     if (_thread.joinable())
@@ -232,17 +349,22 @@ void SearchView::refreshThreads()
         _thread.join();
     }
 
-    bool empty = _threads.empty();
-    std::string selectedId;
+    bool empty = _index.empty();
+    uint64_t selectedId = 0;
 
     if (!empty)
-        selectedId = (*(_threads.begin() + _selectedIndex)).id;
+        selectedId = _index.at(_selectedIndex).id;
 
-    _threads.clear();
+    _index.clear();
+    _pages.clear();
+
+    /* Drop what a snapshot reconciliation found */
+    _reconciliation.reset();
+    _reconcileFailed = false;
 
     /* Start collecting threads in the background */
     _collecting = true;
-    _thread = std::thread(std::bind(&SearchView::collectThreads, this));
+    _thread = std::thread([this] { collectThreads(); });
 
     /* Locate the previously selected thread ID */
     bool found = false;
@@ -254,12 +376,12 @@ void SearchView::refreshThreads()
     {
         int index = 0;
 
-        while (!found && _collecting)
+        while (!found)
         {
-            for (; index < _threads.size(); ++index)
+            for (; index < _index.size(); ++index)
             {
                 /* Stop if we found the thread ID */
-                if (_threads.at(index).id == selectedId)
+                if (_index.at(index).id == selectedId)
                 {
                     found = true;
                     _selectedIndex = index;
@@ -267,111 +389,559 @@ void SearchView::refreshThreads()
                 }
             }
 
+            if (!_collecting)
+                break;
+
             _condition.wait_for(lock, conditionWaitTime);
         }
     }
 
     /* Wait until we have enough threads to fill the screen */
-    while (_threads.size() - _offset < getmaxy(_window) && _collecting)
+    while (_index.size() - _offset < getmaxy(_window) && _collecting)
         _condition.wait_for(lock, conditionWaitTime);
 
     /* If we didn't find it, make sure the selected index is valid */
     if (!found)
     {
-        if (_threads.size() <= _selectedIndex)
-            _selectedIndex = _threads.size() - 1;
+        if (_index.size() <= _selectedIndex)
+            _selectedIndex = std::max<int>(_index.size() - 1, 0);
     }
 
+    lock.unlock();
+
     StatusBar::instance().update();
     makeSelectionVisible();
 }
 
 int SearchView::lineCount() const
 {
-    return _threads.size();
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _index.size();
 }
 
 void SearchView::collectThreads()
+{
+    try
+    {
+        DatabasePool::Handle database = DatabasePool::instance().acquire();
+        collectThreads(database);
+    }
+    catch (const std::exception & e)
+    {
+        StatusBar::instance().postMessage(std::string("Could not search: ") + e.what());
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _collecting = false;
+        }
+
+        _condition.notify_one();
+
+        EventLoop::instance().wake();
+    }
+}
+
+void SearchView::collectThreads(DatabasePool::Handle & database)
 {
     std::unique_lock<std::mutex> lock(_mutex);
     lock.unlock();
 
-    notmuch_database_t * database = Notmuch::readonlyDatabase();
-    notmuch_query_t * query = notmuch_query_create(database, _searchTerms.c_str());
-    notmuch_query_set_sort(query, NerConfig::instance().sortMode());
-    notmuch_threads_t * threadIterator;
+    const char * uuid;
+    unsigned long revision;
+    notmuch_query_t * query;
+    notmuch_messages_t * messages;
 
-    for (threadIterator = notmuch_query_search_threads(query);
-        notmuch_threads_valid(threadIterator) && _collecting;
-        notmuch_threads_move_to_next(threadIterator))
+    /* The search fails if another program has changed the database since the
+     * handle was opened, in which case reopen it and try again */
+    for (int attempt = 0;; ++attempt)
     {
-        lock.lock();
+        revision = notmuch_database_get_revision(database.get(), &uuid);
 
-        notmuch_thread_t * thread = notmuch_threads_get(threadIterator);
-        _threads.push_back(Thread(thread));
+        query = notmuch_query_create(database.get(), _searchTerms.c_str());
+        notmuch_query_set_sort(query, NerConfig::instance().sortMode());
 
-        _condition.notify_one();
+        messages = notmuch_query_search_messages(query);
+
+        if (messages || attempt > 0)
+            break;
+
+        notmuch_query_destroy(query);
+        database.reopen();
+    }
+
+    lock.lock();
+    _revision = revision;
+    _uuid = uuid;
+    lock.unlock();
+
+    /* notmuch orders threads by their first matching message, so walking the
+     * messages and keeping the first occurrence of each thread gives the same
+     * order as notmuch_query_search_threads without building every thread. */
+    std::unordered_set<uint64_t> seenThreads;
+    std::vector<IndexEntry> batch;
+    batch.reserve(indexBatchSize);
+
+    for (; notmuch_messages_valid(messages) && _collecting;
+        notmuch_messages_move_to_next(messages))
+    {
+        notmuch_message_t * message = notmuch_messages_get(messages);
+        uint64_t id = parseThreadId(notmuch_message_get_thread_id(message));
+
+        if (seenThreads.insert(id).second)
+            batch.push_back(IndexEntry{ id, notmuch_message_get_date(message) });
+
+        notmuch_message_destroy(message);
+
+        if (batch.size() >= indexBatchSize)
+        {
+            lock.lock();
+            _index.insert(_index.end(), batch.begin(), batch.end());
+            _condition.notify_one();
+            lock.unlock();
 
-        lock.unlock();
+            /* Show the new threads */
+            EventLoop::instance().wake();
 
-        sched_yield();
+            batch.clear();
+        }
     }
 
+    lock.lock();
+    _index.insert(_index.end(), batch.begin(), batch.end());
+
+    /* Unless it was stopped, or the search failed, the index is complete */
+    if (_collecting && messages)
+        _snapshotOutdated = true;
+
     _collecting = false;
+    lock.unlock();
+
     notmuch_query_destroy(query);
-    notmuch_database_close(database);
 
     /* For cases when there are no matching threads */
     _condition.notify_one();
+
+    EventLoop::instance().wake();
 }
 
-void SearchView::markHam()
+bool SearchView::updateThreads()
+{
+    Update update;
+
+    try
+    {
+        std::unique_ptr<DatabasePool::Handle> database = DatabasePool::instance().tryAcquire();
+
+        if (!database || !findUpdate(*database, update))
+            return false;
+    }
+    catch (const std::exception &)
+    {
+        /* The reload reports the error */
+        return false;
+    }
+
+    applyUpdate(update);
+
+    return true;
+}
+
+bool SearchView::findUpdate(DatabasePool::Handle & database, Update & update) const
+{
+    notmuch_sort_t sortMode = NerConfig::instance().sortMode();
+
+    /* Only date ordered results can be patched by position */
+    if (!dateSorted(sortMode))
+        return false;
+
+    const char * uuid;
+    unsigned long revision = notmuch_database_get_revision(database.get(), &uuid);
+
+    /* The database was rebuilt, so revisions are not comparable */
+    if (_uuid != uuid)
+        return false;
+
+    update.revision = revision;
+
+    if (revision == _revision)
+        return true;
+
+    /* Find the threads with messages modified since the last update */
+    std::ostringstream modifiedQueryString;
+    modifiedQueryString << "lastmod:" << (_revision + 1) << ".." << revision;
+
+    std::unordered_set<uint64_t> & modifiedThreads = update.modifiedThreads;
+
+    notmuch_query_t * query = notmuch_query_create(database.get(), modifiedQueryString.str().c_str());
+    notmuch_messages_t * messages = notmuch_query_search_messages(query);
+
+    /* The handle is out of date, so reopen it for the full reload */
+    if (!messages)
+    {
+        notmuch_query_destroy(query);
+        database.reopen();
+        return false;
+    }
+
+    for (; notmuch_messages_valid(messages);
+        notmuch_messages_move_to_next(messages))
+    {
+        notmuch_message_t * message = notmuch_messages_get(messages);
+        modifiedThreads.insert(parseThreadId(notmuch_message_get_thread_id(message)));
+        notmuch_message_destroy(message);
+    }
+
+    notmuch_query_destroy(query);
+
+    /* Find out which of those threads still match, and where they sort now */
+    std::vector<IndexEntry> & updatedEntries = update.entries;
+    std::vector<uint64_t> ids(modifiedThreads.begin(), modifiedThreads.end());
+
+    for (auto chunk = ids.begin(); chunk != ids.end();)
+    {
+        auto chunkEnd = chunk + std::min<std::ptrdiff_t>(threadPageSize, ids.end() - chunk);
+
+        std::ostringstream queryStream;
+        queryStream << '(' << _searchTerms << ") and (";
+
+        for (auto id = chunk; id != chunkEnd; ++id)
+            queryStream << (id == chunk ? "" : " or ") << "thread:" << formatThreadId(*id);
+
+        queryStream << ')';
+
+        std::unordered_set<uint64_t> seenThreads;
+
+        query = notmuch_query_create(database.get(), queryStream.str().c_str());
+        notmuch_query_set_sort(query, sortMode);
+
+        messages = notmuch_query_search_messages(query);
+
+        if (!messages)
+        {
+            notmuch_query_destroy(query);
+            database.reopen();
+            return false;
+        }
+
+        for (; notmuch_messages_valid(messages);
+            notmuch_messages_move_to_next(messages))
+        {
+            notmuch_message_t * message = notmuch_messages_get(messages);
+            uint64_t id = parseThreadId(notmuch_message_get_thread_id(message));
+
+            if (seenThreads.insert(id).second)
+                updatedEntries.push_back(IndexEntry{ id, notmuch_message_get_date(message) });
+
+            notmuch_message_destroy(message);
+        }
+
+        notmuch_query_destroy(query);
+
+        chunk = chunkEnd;
+    }
+
+    std::stable_sort(updatedEntries.begin(), updatedEntries.end(), indexOrder(sortMode));
+
+    return true;
+}
+
+void SearchView::applyUpdate(const Update & update)
+{
+    if (update.revision == _revision)
+        return;
+
+    const std::unordered_set<uint64_t> & modifiedThreads = update.modifiedThreads;
+    const std::vector<IndexEntry> & updatedEntries = update.entries;
+
+    /* Patch the index in place */
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    uint64_t selectedId = _selectedIndex < _index.size() ? _index[_selectedIndex].id : 0;
+
+    _index.erase(std::remove_if(_index.begin(), _index.end(),
+        [&modifiedThreads](const IndexEntry & entry) {
+            return modifiedThreads.count(entry.id) > 0;
+        }), _index.end());
+
+    std::vector<IndexEntry> index;
+    index.reserve(_index.size() + updatedEntries.size());
+    std::merge(_index.begin(), _index.end(), updatedEntries.begin(), updatedEntries.end(),
+        std::back_inserter(index), indexOrder(NerConfig::instance().sortMode()));
+    _index.swap(index);
+
+    _revision = update.revision;
+    _snapshotOutdated = true;
+
+    /* Keep the selection on the same thread if it still matches */
+    auto selected = std::find_if(_index.begin(), _index.end(),
+        [selectedId](const IndexEntry & entry) { return entry.id == selectedId; });
+
+    if (selected != _index.end())
+        _selectedIndex = selected - _index.begin();
+    else if (_selectedIndex >= _index.size())
+        _selectedIndex = std::max<int>(_index.size() - 1, 0);
+
+    lock.unlock();
+
+    /* The summaries only need rebuilding if threads moved or changed */
+    if (!modifiedThreads.empty())
+        _pages.clear();
+}
+
+void SearchView::reconcileThreads()
+{
+    std::unique_ptr<Update> update(new Update());
+    bool found;
+
+    /* If the database can't be opened, the reload reports it */
+    try
+    {
+        DatabasePool::Handle database = DatabasePool::instance().acquire();
+        found = findUpdate(database, *update);
+    }
+    catch (const std::exception &)
+    {
+        found = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (found)
+            _reconciliation = std::move(update);
+        else
+            _reconcileFailed = true;
+    }
+
+    EventLoop::instance().wake();
+}
+
+bool SearchView::loadSnapshot()
+{
+    SearchSnapshot snapshot(_searchTerms, NerConfig::instance().sortMode());
+
+    if (!snapshot.load())
+        return false;
+
+    _uuid = snapshot.uuid;
+    _revision = snapshot.revision;
+
+    _index.reserve(snapshot.index.size());
+
+    for (auto entry = snapshot.index.begin(), e = snapshot.index.end(); entry != e; ++entry)
+        _index.push_back(IndexEntry{ entry->id, static_cast<time_t>(entry->date) });
+
+    /* The saved summaries fill the first pages, so that the first screen can
+     * be drawn without the database */
+    for (int page = 0; page * threadPageSize < snapshot.threads.size(); ++page)
+    {
+        auto first = snapshot.threads.begin() + page * threadPageSize;
+        int count = std::min<int>(threadPageSize, _index.size() - page * threadPageSize);
+
+        if (count <= 0 || snapshot.threads.end() - first < count)
+            break;
+
+        Page & pageThreads = _pages[page];
+        pageThreads.threads.reserve(count);
+
+        for (auto thread = first, e = first + count; thread != e; ++thread)
+            pageThreads.threads.emplace_back(*thread, pageThreads.strings);
+    }
+
+    return true;
+}
+
+void SearchView::saveSnapshot()
+{
+    std::shared_ptr<SearchSnapshot> snapshot(
+        new SearchSnapshot(_searchTerms, NerConfig::instance().sortMode()));
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        snapshot->uuid = _uuid;
+        snapshot->revision = _revision;
+
+        snapshot->index.reserve(_index.size());
+
+        for (auto entry = _index.begin(), e = _index.end(); entry != e; ++entry)
+            snapshot->index.push_back(SearchSnapshot::Entry{ entry->id, entry->date });
+
+        _snapshotOutdated = false;
+        _savingSnapshot = true;
+    }
+
+    /* Only the first pages are shown before the database is needed. The
+     * summaries are copied into the snapshot's own arena, since the pages may
+     * be evicted while it is written. */
+    int summaries = std::min<int>(snapshot->index.size(), snapshotPages * threadPageSize);
+
+    for (int index = 0; index < summaries; ++index)
+        snapshot->threads.emplace_back(thread(index), snapshot->strings);
+
+    /* The last write has finished, as _savingSnapshot was clear */
+    if (_snapshotThread.joinable())
+        _snapshotThread.join();
+
+    _snapshotThread = std::thread([this, snapshot] {
+        snapshot->save();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _savingSnapshot = false;
+    });
+}
+
+Thread & SearchView::thread(int index)
+{
+    int page = index / threadPageSize;
+    auto pageThreads = _pages.find(page);
+
+    if (pageThreads == _pages.end())
+    {
+        materializePage(page);
+        pageThreads = _pages.find(page);
+    }
+
+    return pageThreads->second.threads.at(index % threadPageSize);
+}
+
+std::string SearchView::threadId(int index) const
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    if (_selectedIndex < _threads.size())
+    return formatThreadId(_index.at(index).id);
+}
+
+void SearchView::materializePage(int page)
+{
+    std::vector<std::string> ids;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (int index = page * threadPageSize;
+            index < _index.size() && index < (page + 1) * threadPageSize; ++index)
+        {
+            ids.push_back(formatThreadId(_index[index].id));
+        }
+    }
+
+    /* Fetch the whole page with a single query, restricted to the search terms
+     * so that the matched message counts stay correct. */
+    std::ostringstream queryStream;
+    queryStream << '(' << _searchTerms << ") and (";
+
+    for (auto id = ids.begin(), e = ids.end(); id != e; ++id)
+        queryStream << (id == ids.begin() ? "" : " or ") << "thread:" << *id;
+
+    queryStream << ')';
+
+    std::map<std::string, notmuch_thread_t *> threads;
+
+    notmuch_query_t * query = notmuch_query_create(Notmuch::database(),
+        queryStream.str().c_str());
+    notmuch_threads_t * threadIterator;
+
+    for (threadIterator = notmuch_query_search_threads(query);
+        notmuch_threads_valid(threadIterator);
+        notmuch_threads_move_to_next(threadIterator))
+    {
+        notmuch_thread_t * thread = notmuch_threads_get(threadIterator);
+        threads[notmuch_thread_get_thread_id(thread)] = thread;
+    }
+
+    Page & pageThreads = _pages[page];
+    pageThreads.threads.reserve(ids.size());
+
+    for (auto id = ids.begin(), e = ids.end(); id != e; ++id)
+    {
+        auto thread = threads.find(*id);
+
+        if (thread != threads.end())
+            pageThreads.threads.emplace_back(thread->second, pageThreads.strings);
+        else
+        {
+            /* The thread no longer matches the search, so fall back to its
+             * unrestricted summary. */
+            try
+            {
+                notmuch_query_t * threadQuery = NULL;
+                notmuch_thread_t * unrestricted = Notmuch::thread(*id, &threadQuery);
+                pageThreads.threads.emplace_back(unrestricted, pageThreads.strings);
+                notmuch_query_destroy(threadQuery);
+            }
+            catch (const InvalidThreadException & e)
+            {
+                pageThreads.threads.emplace_back(*id, pageThreads.strings);
+            }
+        }
+    }
+
+    notmuch_query_destroy(query);
+}
+
+void SearchView::evictPages()
+{
+    /* Keep one page of slack on either side of the visible window */
+    int firstPage = std::max(_offset / threadPageSize - 1, 0);
+    int lastPage = (_offset + visibleLines()) / threadPageSize + 1;
+
+    for (auto page = _pages.begin(); page != _pages.end();)
     {
-        Thread & thread = _threads.at(_selectedIndex);
+        if (page->first < firstPage || page->first > lastPage)
+            page = _pages.erase(page);
+        else
+            ++page;
+    }
+}
+
+void SearchView::markHam()
+{
+    if (_selectedIndex < lineCount())
+    {
+        Thread & thread = this->thread(_selectedIndex);
         thread.addTag("ham");
+        invalidateLine(_selectedIndex);
         next();
-        update();
     }
 }
 
 void SearchView::markToggle()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    if (_selectedIndex < _threads.size())
+    if (_selectedIndex < lineCount())
     {
-        Thread & thread = _threads.at(_selectedIndex);
+        Thread & thread = this->thread(_selectedIndex);
         thread.addTag("toggle");
+        invalidateLine(_selectedIndex);
         next();
-        update();
     }
 }
 
 void SearchView::clearMarks()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    if (_selectedIndex < _threads.size())
+    if (_selectedIndex < lineCount())
     {
-        Thread & thread = _threads.at(_selectedIndex);
-        thread.removeTag("ham");
-        thread.removeTag("toggle");
+        Thread & thread = this->thread(_selectedIndex);
+        thread.tags.erase("ham");
+        thread.tags.erase("toggle");
+
+        Notmuch::TagBatch batch;
+        batch.addThread(thread.id);
+        batch.removeTag("ham");
+        batch.removeTag("toggle");
+        batch.commit();
+
+        invalidateLine(_selectedIndex);
         next();
-        update();
     }
 }
 
 void SearchView::addTags()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    if (_selectedIndex < _threads.size())
+    if (_selectedIndex < lineCount())
     {
-        Thread & thread = _threads.at(_selectedIndex);
+        Thread & thread = this->thread(_selectedIndex);
 
         try
         {
@@ -381,12 +951,21 @@ void SearchView::addTags()
                 std::stringstream ss(tags);
                 std::string s;
 
+                Notmuch::TagBatch batch;
+                batch.addThread(thread.id);
+
                 while (std::getline(ss, s, ' ')) {
-                    thread.addTag(s);
+                    if (s.empty())
+                        continue;
+
+                    thread.tags.insert(s);
+                    batch.addTag(s);
                 }
 
+                batch.commit();
+
+                invalidateLine(_selectedIndex);
                 next();
-                update();
             }
         }
         catch (const AbortInputException&)
@@ -397,11 +976,9 @@ void SearchView::addTags()
 
 void SearchView::removeTags()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    if (_selectedIndex < _threads.size())
+    if (_selectedIndex < lineCount())
     {
-        Thread & thread = _threads.at(_selectedIndex);
+        Thread & thread = this->thread(_selectedIndex);
 
         try
         {
@@ -411,12 +988,21 @@ void SearchView::removeTags()
                 std::stringstream ss(tags);
                 std::string s;
 
+                Notmuch::TagBatch batch;
+                batch.addThread(thread.id);
+
                 while (std::getline(ss, s, ' ')) {
-                    thread.removeTag(s);
+                    if (s.empty())
+                        continue;
+
+                    thread.tags.erase(s);
+                    batch.removeTag(s);
                 }
 
+                batch.commit();
+
+                invalidateLine(_selectedIndex);
                 next();
-                update();
             }
         }
         catch (const AbortInputException&)
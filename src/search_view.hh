@@ -21,11 +21,18 @@
 #define NER_SEARCH_VIEW 1
 
 #include <string>
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <memory>
+#include <functional>
 #include <thread>
+#include <stdint.h>
 
 #include "line_browser_view.hh"
 #include "notmuch.hh"
 #include "thread.hh"
+#include "database_pool.hh"
 
 class SearchView : public LineBrowserView
 {
@@ -52,18 +59,135 @@ class SearchView : public LineBrowserView
 
     protected:
         virtual int lineCount() const;
+        virtual void displayLine(int index);
 
     private:
+        /**
+         * A compact reference to a matching thread.
+         *
+         * One of these is kept for every result; full Thread summaries are
+         * only built for the pages around the visible window.
+         */
+        struct IndexEntry
+        {
+            uint64_t id;
+            time_t date;
+        };
+
+        /**
+         * The summaries of a page of threads. Their strings are freed in one
+         * go when the page is evicted.
+         */
+        struct Page
+        {
+            StringArena strings;
+            std::vector<Thread> threads;
+        };
+
+        /**
+         * The changes to the index since its revision.
+         */
+        struct Update
+        {
+            unsigned long revision;
+            std::unordered_set<uint64_t> modifiedThreads;
+
+            /* The modified threads which still match, in order */
+            std::vector<IndexEntry> entries;
+        };
+
+        static std::function<bool (const IndexEntry &, const IndexEntry &)>
+            indexOrder(notmuch_sort_t sortMode);
+
+        /**
+         * Collects the matching threads into the index, in the background.
+         * Errors are shown in the status bar.
+         */
         void collectThreads();
+        void collectThreads(DatabasePool::Handle & database);
+
+        /**
+         * Restarts the search from scratch.
+         */
+        void reloadThreads();
+
+        /**
+         * Patches the collected threads with the messages that changed since
+         * the last collection or update.
+         *
+         * This does not wait for a database handle, so it doesn't block the
+         * UI while the pool is busy; a full reload is needed instead.
+         *
+         * \return Whether the update could be performed incrementally.
+         */
+        bool updateThreads();
+
+        /**
+         * Finds the changes to apply to the index. This does not modify the
+         * view, so it may be called from the background thread.
+         *
+         * \param database The handle to search with.
+         * \param update The changes found are stored here.
+         * \return Whether the index can be updated incrementally.
+         */
+        bool findUpdate(DatabasePool::Handle & database, Update & update) const;
+        void applyUpdate(const Update & update);
+
+        /**
+         * Shows the results saved by an earlier session, if there are any.
+         *
+         * \return Whether the index was loaded from a snapshot.
+         */
+        bool loadSnapshot();
+
+        /**
+         * Saves the results, writing the file in the background.
+         */
+        void saveSnapshot();
+
+        /**
+         * Finds the changes since the index was loaded from a snapshot, for
+         * update to apply.
+         */
+        void reconcileThreads();
+
+        /**
+         * Returns the summary of the thread at the given index, materializing
+         * the page containing it if necessary.
+         */
+        Thread & thread(int index);
+        std::string threadId(int index) const;
+
+        void materializePage(int page);
+        void evictPages();
 
         std::string _searchTerms;
 
         std::thread _thread;
-        std::mutex _mutex;
+        mutable std::mutex _mutex;
         std::condition_variable _condition;
         bool _collecting;
 
-        std::vector<Thread> _threads;
+        /* The database revision the index is up to date with */
+        unsigned long _revision;
+        std::string _uuid;
+
+        std::vector<IndexEntry> _index;
+        std::map<int, Page> _pages;
+
+        /* Whether the results of this search are saved between sessions */
+        bool _snapshotted;
+
+        /* Whether the index has changed since the snapshot was saved */
+        bool _snapshotOutdated;
+
+        /* Writes the snapshot, while _savingSnapshot is set */
+        std::thread _snapshotThread;
+        bool _savingSnapshot;
+
+        /* Set by reconcileThreads once it is done */
+        std::unique_ptr<Update> _reconciliation;
+        bool _reconcileFailed;
 };
 
 #endif
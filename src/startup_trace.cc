@@ -0,0 +1,93 @@
+/* ner: src/startup_trace.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iomanip>
+
+#include "startup_trace.hh"
+
+StartupTrace * StartupTrace::_instance = 0;
+
+StartupTrace::StartupTrace()
+    : _start(Clock::now()), _lastEnd(_start)
+{
+    _instance = this;
+}
+
+StartupTrace::~StartupTrace()
+{
+    _instance = 0;
+}
+
+void StartupTrace::record(const std::string & phase, Clock::time_point start)
+{
+    Clock::time_point end = Clock::now();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto recorded = std::find_if(_phases.begin(), _phases.end(),
+        [&phase](const Phase & p) { return p.name == phase; });
+
+    if (recorded == _phases.end())
+        _phases.push_back(Phase{ phase, start, end });
+
+    _lastEnd = std::max(_lastEnd, end);
+}
+
+void StartupTrace::record(const std::string & phase)
+{
+    Clock::time_point start;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        start = _lastEnd;
+    }
+
+    record(phase, start);
+}
+
+void StartupTrace::report(std::ostream & stream) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<Phase> phases(_phases);
+    std::stable_sort(phases.begin(), phases.end(),
+        [](const Phase & a, const Phase & b) { return a.end < b.end; });
+
+    auto milliseconds = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    stream << std::left << std::setw(24) << "phase"
+        << std::right << std::setw(10) << "start" << std::setw(10) << "end"
+        << std::setw(10) << "duration" << std::endl;
+
+    stream << std::fixed << std::setprecision(1);
+
+    for (auto phase = phases.begin(), e = phases.end(); phase != e; ++phase)
+    {
+        stream << std::left << std::setw(24) << phase->name
+            << std::right << std::setw(10) << milliseconds(phase->start - _start)
+            << std::setw(10) << milliseconds(phase->end - _start)
+            << std::setw(10) << milliseconds(phase->end - phase->start) << std::endl;
+    }
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -0,0 +1,96 @@
+/* ner: src/startup_trace.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_STARTUP_TRACE_H
+#define NER_STARTUP_TRACE_H 1
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+
+/**
+ * Records when each phase of startup begins and ends.
+ *
+ * Recording only happens while an instance exists, which is the case when ner
+ * is run with --startup-trace. Phases may be recorded from any thread, since
+ * some of them run in the background.
+ *
+ * This class is a singleton.
+ */
+class StartupTrace
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        static bool enabled()
+        {
+            return _instance;
+        }
+
+        static StartupTrace & instance()
+        {
+            return *_instance;
+        }
+
+        StartupTrace();
+        ~StartupTrace();
+
+        /**
+         * Records a phase which ran from start until now.
+         *
+         * Only the first phase recorded with a given name is kept.
+         */
+        void record(const std::string & phase, Clock::time_point start);
+
+        /**
+         * Records a phase which ran from the end of the last one until now.
+         */
+        void record(const std::string & phase);
+
+        /**
+         * Writes when each phase started and ended, in milliseconds since
+         * the trace was started, and how long it took.
+         *
+         * \param stream The stream to write the report to.
+         */
+        void report(std::ostream & stream) const;
+
+    private:
+        struct Phase
+        {
+            std::string name;
+            Clock::time_point start;
+            Clock::time_point end;
+        };
+
+        static StartupTrace * _instance;
+
+        mutable std::mutex _mutex;
+
+        Clock::time_point _start;
+        Clock::time_point _lastEnd;
+        std::vector<Phase> _phases;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
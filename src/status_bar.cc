@@ -30,22 +30,22 @@ StatusBar * StatusBar::_instance = 0;
 StatusBar::StatusBar()
     : _statusWindow(newwin(1, COLS, LINES - 2, 0)),
         _promptWindow(newwin(1, COLS, LINES - 1, 0)),
-        _messageCleared(true)
+        _messageCleared(true),
+        _messageClearTimer(0)
 {
     _instance = this;
 
     wbkgd(_statusWindow, COLOR_PAIR(ColorID::StatusBarStatus));
 
-    wrefresh(_statusWindow);
-    wrefresh(_promptWindow);
+    wnoutrefresh(_statusWindow);
+    wnoutrefresh(_promptWindow);
 }
 
 StatusBar::~StatusBar()
 {
     _instance = 0;
 
-    if (_messageClearThread.joinable())
-        _messageClearThread.join();
+    EventLoop::instance().cancelTimer(_messageClearTimer);
 }
 
 void StatusBar::update()
@@ -84,8 +84,8 @@ void StatusBar::update()
 
 void StatusBar::refresh()
 {
-    wrefresh(_statusWindow);
-    wrefresh(_promptWindow);
+    wnoutrefresh(_statusWindow);
+    wnoutrefresh(_promptWindow);
 }
 
 void StatusBar::resize()
@@ -107,14 +107,18 @@ void StatusBar::displayMessage(const std::string & message)
     waddstr(_promptWindow, message.c_str());
     wattroff(_promptWindow, A_BOLD);
 
-    wrefresh(_promptWindow);
+    wnoutrefresh(_promptWindow);
 
     _messageCleared = false;
 
-    if (_messageClearThread.joinable())
-        _messageClearThread.detach();
+    EventLoop::instance().cancelTimer(_messageClearTimer);
+    _messageClearTimer = EventLoop::instance().addTimer(std::chrono::milliseconds(1500),
+        std::bind(&StatusBar::clearMessage, this));
+}
 
-    _messageClearThread = std::thread(std::bind(&StatusBar::delayedClearMessage, this, 1500));
+void StatusBar::postMessage(const std::string & message)
+{
+    EventLoop::instance().post([this, message] { displayMessage(message); });
 }
 
 std::string StatusBar::prompt(const std::string & message, const std::string & field,
@@ -143,21 +147,13 @@ std::string StatusBar::prompt(const std::string & message, const std::string & f
     return response;
 }
 
-void StatusBar::delayedClearMessage(int delay)
-{
-    usleep(delay * 1000);
-
-    if (_messageCleared)
-        return;
-
-    clearMessage();
-}
-
 void StatusBar::clearMessage()
 {
+    EventLoop::instance().cancelTimer(_messageClearTimer);
+
     werase(_promptWindow);
     wbkgd(_promptWindow, COLOR_PAIR(ColorID::StatusBarPrompt));
-    wrefresh(_promptWindow);
+    wnoutrefresh(_promptWindow);
     _messageCleared = true;
 }
 
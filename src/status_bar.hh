@@ -22,9 +22,9 @@
 
 #include <string>
 #include <vector>
-#include <thread>
 
 #include "ncurses.hh"
+#include "event_loop.hh"
 
 class StatusBar
 {
@@ -44,20 +44,27 @@ class StatusBar
         void resize();
 
         void displayMessage(const std::string & message);
+
+        /**
+         * Posts a message to the event loop, to be displayed on the user
+         * interface thread.
+         *
+         * Unlike displayMessage, this may be called from any thread.
+         */
+        void postMessage(const std::string & message);
         std::string prompt(const std::string & message, const std::string & field = std::string(),
                            const std::string & initialValue = std::string());
 
     private:
         static StatusBar * _instance;
 
-        void delayedClearMessage(int delay);
         void clearMessage();
 
         WINDOW * _statusWindow;
         WINDOW * _promptWindow;
 
         bool _messageCleared;
-        std::thread _messageClearThread;
+        EventLoop::Timer _messageClearTimer;
 };
 
 #endif
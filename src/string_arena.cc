@@ -0,0 +1,101 @@
+/* ner: src/string_arena.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "string_arena.hh"
+
+StringArena::StringArena(size_t chunkSize)
+    : _chunkSize(chunkSize), _position(NULL), _remaining(0)
+{
+}
+
+StringArena::StringArena(StringArena && other)
+    : _chunkSize(other._chunkSize), _chunks(std::move(other._chunks)),
+        _position(other._position), _remaining(other._remaining)
+{
+    other.clear();
+}
+
+StringArena & StringArena::operator=(StringArena && other)
+{
+    _chunkSize = other._chunkSize;
+    _chunks = std::move(other._chunks);
+    _position = other._position;
+    _remaining = other._remaining;
+
+    other.clear();
+
+    return *this;
+}
+
+const char * StringArena::add(const char * string, size_t length)
+{
+    size_t size = length + 1;
+    char * copy;
+
+    if (size > _remaining)
+    {
+        /* Large strings get a chunk of their own, so that the free space left
+         * in the current one is not wasted */
+        if (size > _chunkSize / 4)
+        {
+            _chunks.emplace_back(new char[size]);
+            copy = _chunks.back().get();
+
+            std::memcpy(copy, string, length);
+            copy[length] = '\0';
+
+            return copy;
+        }
+
+        _chunks.emplace_back(new char[_chunkSize]);
+        _position = _chunks.back().get();
+        _remaining = _chunkSize;
+    }
+
+    copy = _position;
+    std::memcpy(copy, string, length);
+    copy[length] = '\0';
+
+    _position += size;
+    _remaining -= size;
+
+    return copy;
+}
+
+const char * StringArena::add(const char * string)
+{
+    return add(string, std::strlen(string));
+}
+
+const char * StringArena::add(const std::string & string)
+{
+    return add(string.data(), string.size());
+}
+
+void StringArena::clear()
+{
+    _chunks.clear();
+    _position = NULL;
+    _remaining = 0;
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -0,0 +1,78 @@
+/* ner: src/string_arena.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_STRING_ARENA_H
+#define NER_STRING_ARENA_H 1
+
+#include <string>
+#include <vector>
+#include <memory>
+
+/**
+ * Append-only storage for strings which are all freed together.
+ *
+ * Strings are copied, null-terminated, into large chunks, so adding one
+ * rarely allocates. They stay at the same address until the arena is cleared
+ * or destroyed, including when it is moved.
+ */
+class StringArena
+{
+    public:
+        StringArena(size_t chunkSize = 8192);
+        StringArena(StringArena && other);
+        StringArena & operator=(StringArena && other);
+
+        /**
+         * Copies a string into the arena.
+         *
+         * \return The copy, which lives as long as the arena's contents.
+         */
+        const char * add(const char * string, size_t length);
+
+        /**
+         * \overload
+         */
+        const char * add(const char * string);
+
+        /**
+         * \overload
+         */
+        const char * add(const std::string & string);
+
+        /**
+         * Frees every string in the arena.
+         */
+        void clear();
+
+    private:
+        StringArena(const StringArena &) = delete;
+        StringArena & operator=(const StringArena &) = delete;
+
+        size_t _chunkSize;
+        std::vector<std::unique_ptr<char[]>> _chunks;
+
+        /* The free space at the end of the current chunk */
+        char * _position;
+        size_t _remaining;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
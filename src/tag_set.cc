@@ -0,0 +1,171 @@
+/* ner: src/tag_set.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+#include <stdexcept>
+
+#include "tag_set.hh"
+
+/* Function local, so that tags can be interned during static
+ * initialization */
+static std::mutex & internMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::unordered_map<std::string, TagSet::Tag> & tagNumbers()
+{
+    static std::unordered_map<std::string, TagSet::Tag> numbers;
+    return numbers;
+}
+
+/* A deque, so that references to names stay valid as it grows */
+static std::deque<std::string> & tagNames()
+{
+    static std::deque<std::string> names;
+    return names;
+}
+
+TagSet::Tag TagSet::intern(const std::string & name)
+{
+    std::lock_guard<std::mutex> lock(internMutex());
+
+    auto number = tagNumbers().find(name);
+
+    if (number != tagNumbers().end())
+        return number->second;
+
+    if (tagNames().size() > UINT16_MAX)
+        throw std::length_error("Too many distinct tags");
+
+    Tag tag = tagNames().size();
+    tagNames().push_back(name);
+    tagNumbers().insert(std::make_pair(name, tag));
+
+    return tag;
+}
+
+const std::string & TagSet::name(Tag tag)
+{
+    std::lock_guard<std::mutex> lock(internMutex());
+
+    return tagNames().at(tag);
+}
+
+TagSet::TagSet()
+    : _bits(0)
+{
+}
+
+bool TagSet::contains(Tag tag) const
+{
+    if (tag < wordBits)
+        return _bits & (uint64_t(1) << tag);
+
+    return std::binary_search(_overflow.begin(), _overflow.end(), tag);
+}
+
+void TagSet::insert(Tag tag)
+{
+    if (tag < wordBits)
+        _bits |= uint64_t(1) << tag;
+    else
+    {
+        auto position = std::lower_bound(_overflow.begin(), _overflow.end(), tag);
+
+        if (position == _overflow.end() || *position != tag)
+            _overflow.insert(position, tag);
+    }
+}
+
+void TagSet::erase(Tag tag)
+{
+    if (tag < wordBits)
+        _bits &= ~(uint64_t(1) << tag);
+    else
+    {
+        auto position = std::lower_bound(_overflow.begin(), _overflow.end(), tag);
+
+        if (position != _overflow.end() && *position == tag)
+            _overflow.erase(position);
+    }
+}
+
+bool TagSet::contains(const std::string & name) const
+{
+    return contains(intern(name));
+}
+
+void TagSet::insert(const std::string & name)
+{
+    insert(intern(name));
+}
+
+void TagSet::erase(const std::string & name)
+{
+    erase(intern(name));
+}
+
+bool TagSet::empty() const
+{
+    return _bits == 0 && _overflow.empty();
+}
+
+size_t TagSet::size() const
+{
+    return __builtin_popcountll(_bits) + _overflow.size();
+}
+
+std::vector<TagSet::Tag> TagSet::sorted() const
+{
+    std::vector<Tag> tags;
+    tags.reserve(size());
+
+    for (uint64_t bits = _bits; bits; bits &= bits - 1)
+        tags.push_back(__builtin_ctzll(bits));
+
+    tags.insert(tags.end(), _overflow.begin(), _overflow.end());
+
+    std::sort(tags.begin(), tags.end(), [](Tag a, Tag b) { return name(a) < name(b); });
+
+    return tags;
+}
+
+std::string TagSet::toString() const
+{
+    std::vector<Tag> tags(sorted());
+    std::string string;
+
+    for (auto tag = tags.begin(), e = tags.end(); tag != e; ++tag)
+    {
+        if (tag != tags.begin())
+            string.push_back(' ');
+
+        string.append(name(*tag));
+    }
+
+    return string;
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
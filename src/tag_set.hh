@@ -0,0 +1,97 @@
+/* ner: src/tag_set.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_TAG_SET_H
+#define NER_TAG_SET_H 1
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * A set of tags, such as those of a thread or message.
+ *
+ * Tag names are interned, so that each distinct tag is stored once and
+ * referred to by a small integer. The first 64 tags to be interned, which
+ * normally covers every tag in use, are kept as bits in a single word;
+ * further ones are kept in a sorted array.
+ */
+class TagSet
+{
+    public:
+        typedef uint16_t Tag;
+
+        /**
+         * Returns the number of a tag, assigning it one if it has none.
+         *
+         * This may be called from any thread.
+         */
+        static Tag intern(const std::string & name);
+
+        static const std::string & name(Tag tag);
+
+        TagSet();
+
+        bool contains(Tag tag) const;
+        void insert(Tag tag);
+        void erase(Tag tag);
+
+        /**
+         * \overload
+         */
+        bool contains(const std::string & name) const;
+
+        /**
+         * \overload
+         */
+        void insert(const std::string & name);
+
+        /**
+         * \overload
+         */
+        void erase(const std::string & name);
+
+        bool empty() const;
+        size_t size() const;
+
+        /**
+         * Returns the tags, ordered by name.
+         */
+        std::vector<Tag> sorted() const;
+
+        /**
+         * Returns the names of the tags, ordered by name and separated by
+         * spaces.
+         */
+        std::string toString() const;
+
+    private:
+        static const Tag wordBits = 64;
+
+        /* Tags below wordBits */
+        uint64_t _bits;
+
+        /* Any others, in ascending order */
+        std::vector<Tag> _overflow;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
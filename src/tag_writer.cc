@@ -0,0 +1,261 @@
+/* ner: src/tag_writer.cc
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <functional>
+#include <iomanip>
+
+#include "tag_writer.hh"
+#include "status_bar.hh"
+#include "event_loop.hh"
+
+/* How long to wait for more changes before writing a batch */
+const auto coalesceDelay = std::chrono::milliseconds(50);
+
+/* Writes taking longer than this are reported in the status bar */
+const auto slowWriteTime = std::chrono::milliseconds(1000);
+
+TagWriter * TagWriter::_instance = 0;
+
+TagWriter::TagWriter()
+    : _running(true), _flushing(false), _writing(false),
+        _statistics{ 0, 0, std::chrono::microseconds(0) }
+{
+    _instance = this;
+
+    _thread = std::thread(std::bind(&TagWriter::run, this));
+}
+
+TagWriter::~TagWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _condition.notify_one();
+    _thread.join();
+
+    _instance = 0;
+}
+
+void TagWriter::enqueue(const Notmuch::TagBatch & batch)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto queue = [this, &batch](const Target & target) {
+        /* A thread and a message in it may share messages, so changes to a
+         * tag are only merged into an earlier entry if no entry since then
+         * changes the same tag */
+        auto conflicts = [&batch](const Changes & changes) {
+            for (auto tag = batch._addedTags.begin(), e = batch._addedTags.end(); tag != e; ++tag)
+                if (changes.count(*tag))
+                    return true;
+
+            for (auto tag = batch._removedTags.begin(), e = batch._removedTags.end(); tag != e; ++tag)
+                if (changes.count(*tag))
+                    return true;
+
+            return false;
+        };
+
+        auto entry = _pending.rbegin();
+
+        for (; entry != _pending.rend() && entry->target != target; ++entry)
+        {
+            if (conflicts(entry->changes))
+            {
+                entry = _pending.rend();
+                break;
+            }
+        }
+
+        if (entry == _pending.rend())
+        {
+            _pending.push_back(PendingChange{ target, Changes() });
+            entry = _pending.rbegin();
+        }
+
+        Changes & changes = entry->changes;
+
+        for (auto tag = batch._addedTags.begin(), e = batch._addedTags.end(); tag != e; ++tag)
+            changes[*tag] = true;
+
+        for (auto tag = batch._removedTags.begin(), e = batch._removedTags.end(); tag != e; ++tag)
+            changes[*tag] = false;
+    };
+
+    for (auto id = batch._threadIds.begin(), e = batch._threadIds.end(); id != e; ++id)
+        queue(Target(true, *id));
+
+    for (auto id = batch._messageIds.begin(), e = batch._messageIds.end(); id != e; ++id)
+        queue(Target(false, *id));
+
+    lock.unlock();
+
+    _condition.notify_one();
+}
+
+void TagWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _flushing = true;
+    _condition.notify_one();
+
+    _written.wait(lock, [this] { return _pending.empty() && !_writing; });
+
+    _flushing = false;
+}
+
+TagWriter::Statistics TagWriter::statistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _statistics;
+}
+
+void TagWriter::Statistics::report(std::ostream & stream) const
+{
+    stream << std::right << std::setw(8) << "batches" << std::setw(10) << "messages"
+        << std::setw(10) << "duration" << std::endl;
+
+    stream << std::fixed << std::setprecision(1)
+        << std::setw(8) << batches << std::setw(10) << messages
+        << std::setw(10) << std::chrono::duration<double, std::milli>(duration).count()
+        << std::endl;
+}
+
+void TagWriter::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _condition.wait(lock, [this] { return !_pending.empty() || !_running; });
+
+        if (_pending.empty())
+            break;
+
+        /* Give changes arriving in quick succession a chance to be coalesced */
+        _condition.wait_for(lock, coalesceDelay, [this] { return !_running || _flushing; });
+
+        PendingChanges pending;
+        pending.swap(_pending);
+        _writing = true;
+
+        lock.unlock();
+        write(pending);
+        lock.lock();
+
+        _writing = false;
+        _written.notify_all();
+    }
+}
+
+void TagWriter::write(const PendingChanges & pending)
+{
+    /* Consecutive targets with the same changes share a batch; the batches
+     * are applied in order */
+    std::vector<Notmuch::TagBatch> batches;
+    const Changes * batchChanges = NULL;
+
+    for (auto entry = pending.begin(), e = pending.end(); entry != e; ++entry)
+    {
+        if (!batchChanges || *batchChanges != entry->changes)
+        {
+            batches.push_back(Notmuch::TagBatch());
+            batchChanges = &entry->changes;
+
+            for (auto change = entry->changes.begin(), e = entry->changes.end(); change != e; ++change)
+            {
+                if (change->second)
+                    batches.back().addTag(change->first);
+                else
+                    batches.back().removeTag(change->first);
+            }
+        }
+
+        if (entry->target.first)
+            batches.back().addThread(entry->target.second);
+        else
+            batches.back().addMessage(entry->target.second);
+    }
+
+    notmuch_database_t * database;
+
+    try
+    {
+        database = Notmuch::openDatabase(NOTMUCH_DATABASE_MODE_READ_WRITE);
+    }
+    catch (const std::exception & e)
+    {
+        StatusBar::instance().postMessage(std::string("Could not change tags: ") + e.what());
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned messages = 0;
+
+    notmuch_status_t status = notmuch_database_begin_atomic(database);
+
+    if (status == NOTMUCH_STATUS_SUCCESS)
+    {
+        for (auto batch = batches.begin(), e = batches.end(); batch != e; ++batch)
+        {
+            Notmuch::TagBatch::Result result = batch->apply(database);
+
+            messages += result.messages;
+
+            if (status == NOTMUCH_STATUS_SUCCESS)
+                status = result.status;
+        }
+
+        notmuch_status_t endStatus = notmuch_database_end_atomic(database);
+
+        if (status == NOTMUCH_STATUS_SUCCESS)
+            status = endStatus;
+    }
+
+    notmuch_database_destroy(database);
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        ++_statistics.batches;
+        _statistics.messages += messages;
+        _statistics.duration += duration;
+    }
+
+    Notmuch::invalidateDatabase();
+
+    if (status != NOTMUCH_STATUS_SUCCESS)
+        StatusBar::instance().postMessage(std::string("Could not change tags: ") +
+            notmuch_status_to_string(status));
+    else if (duration > slowWriteTime)
+        StatusBar::instance().postMessage("Changing tags on " + std::to_string(messages) +
+            " messages took " + std::to_string(duration.count() / 1000) + " ms");
+
+    /* Let the views show the new tags */
+    EventLoop::instance().wake();
+}
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
@@ -0,0 +1,124 @@
+/* ner: src/tag_writer.hh
+ *
+ * Copyright (c) 2010 Michael Forney
+ *
+ * This file is a part of ner.
+ *
+ * ner is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License version 3, as published by the Free
+ * Software Foundation.
+ *
+ * ner is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ner.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NER_TAG_WRITER_H
+#define NER_TAG_WRITER_H 1
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+
+#include "notmuch.hh"
+
+/**
+ * Writes tag changes to the database in the background.
+ *
+ * Queued changes to the same thread or message are coalesced, with the last
+ * change to a tag winning, and are written in the order they were queued, in
+ * batches inside a single atomic section. The database is only opened for
+ * writing while a batch is written, so that other programs are not locked
+ * out. Slow writes are noted in the status bar.
+ *
+ * This class is a singleton.
+ */
+class TagWriter
+{
+    public:
+        struct Statistics
+        {
+            unsigned batches;
+            unsigned messages;
+            std::chrono::microseconds duration;
+
+            /**
+             * Writes the counters, and the total time spent writing in
+             * milliseconds.
+             *
+             * \param stream The stream to write the report to.
+             */
+            void report(std::ostream & stream) const;
+        };
+
+        static TagWriter & instance()
+        {
+            return *_instance;
+        }
+
+        TagWriter();
+
+        /**
+         * Writes any remaining changes before returning.
+         */
+        ~TagWriter();
+
+        /**
+         * Queues the changes in the given batch.
+         */
+        void enqueue(const Notmuch::TagBatch & batch);
+
+        /**
+         * Waits until all queued changes have been written.
+         */
+        void flush();
+
+        Statistics statistics() const;
+
+    private:
+        static TagWriter * _instance;
+
+        /* Whether the target is a thread, and its ID */
+        typedef std::pair<bool, std::string> Target;
+
+        /* For each tag, whether it is added or removed */
+        typedef std::map<std::string, bool> Changes;
+
+        struct PendingChange
+        {
+            Target target;
+            Changes changes;
+        };
+
+        /* In the order they were queued */
+        typedef std::vector<PendingChange> PendingChanges;
+
+        void run();
+        void write(const PendingChanges & pending);
+
+        std::thread _thread;
+        mutable std::mutex _mutex;
+        std::condition_variable _condition;
+        std::condition_variable _written;
+
+        bool _running;
+        bool _flushing;
+        bool _writing;
+
+        PendingChanges _pending;
+        Statistics _statistics;
+};
+
+#endif
+
+// vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
+
@@ -17,10 +17,10 @@ const char * InvalidThreadException::what() const throw()
 
 
 
-Thread::Thread(notmuch_thread_t * thread)
-    : id(notmuch_thread_get_thread_id(thread)),
-      subject(notmuch_thread_get_subject(thread) ? : "(null)"),
-      authors(notmuch_thread_get_authors(thread) ? : "(null)"),
+Thread::Thread(notmuch_thread_t * thread, StringArena & strings)
+    : id(strings.add(notmuch_thread_get_thread_id(thread))),
+      subject(strings.add(notmuch_thread_get_subject(thread) ? : "(null)")),
+      authors(strings.add(notmuch_thread_get_authors(thread) ? : "(null)")),
       totalMessages(notmuch_thread_get_total_messages(thread)),
       matchedMessages(notmuch_thread_get_matched_messages(thread)),
       newestDate(notmuch_thread_get_newest_date(thread)),
@@ -37,44 +37,45 @@ Thread::Thread(notmuch_thread_t * thread)
     notmuch_tags_destroy(tagIterator);
 }
 
-void Thread::topLevelMessages(std::vector<Message> & messages)
+Thread::Thread(const std::string & threadId, StringArena & strings)
+    : id(strings.add(threadId)),
+      subject("(null)"),
+      authors("(null)"),
+      totalMessages(0),
+      matchedMessages(0),
+      newestDate(0),
+      oldestDate(0)
 {
-    notmuch_query_t * query = NULL;
-    notmuch_thread_t * thread = Notmuch::thread(id, &query);
-
-    messages.clear();
-
-    notmuch_messages_t * x;
-    for (x = notmuch_thread_get_toplevel_messages(thread);
-        notmuch_messages_valid(x);
-        notmuch_messages_move_to_next(x))
-    {
-        messages.push_back(*new Message(notmuch_messages_get(x)));
-    }
+}
 
-    notmuch_query_destroy(query);
+Thread::Thread(const Thread & thread, StringArena & strings)
+    : id(strings.add(thread.id)),
+      subject(strings.add(thread.subject)),
+      authors(strings.add(thread.authors)),
+      totalMessages(thread.totalMessages),
+      matchedMessages(thread.matchedMessages),
+      newestDate(thread.newestDate),
+      oldestDate(thread.oldestDate),
+      tags(thread.tags)
+{
 }
 
 void Thread::addTag(std::string tag)
 {
     tags.insert(tag);
 
-    std::vector<Message> messages;
-    topLevelMessages(messages);
-
-    for (Message m : messages) {
-        m.addTagRecursive(tag);
-    }
+    Notmuch::TagBatch batch;
+    batch.addThread(id);
+    batch.addTag(tag);
+    batch.commit();
 }
 
 void Thread::removeTag(std::string tag)
 {
     tags.erase(tag);
 
-    std::vector<Message> messages;
-    topLevelMessages(messages);
-
-    for (Message m : messages) {
-        m.removeTagRecursive(tag);
-    }
+    Notmuch::TagBatch batch;
+    batch.addThread(id);
+    batch.removeTag(tag);
+    batch.commit();
 }
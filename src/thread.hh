@@ -2,9 +2,10 @@
 #define NER_THREAD_H 1
 
 #include <string>
-#include <set>
 
 #include "message.hh"
+#include "tag_set.hh"
+#include "string_arena.hh"
 
 #include "notmuch.h"
 
@@ -20,21 +21,43 @@ class InvalidThreadException : public std::exception
         std::string _id;
 };
 
+/**
+ * The summary of a thread.
+ *
+ * Its strings are stored in the StringArena given to the constructor, so it
+ * must not outlive the arena's contents.
+ */
 class Thread
 {
     public:
-        Thread(notmuch_thread_t * thread);
+        Thread(notmuch_thread_t * thread, StringArena & strings);
 
+        /**
+         * Creates an empty summary for a thread that could not be found.
+         */
+        Thread(const std::string & threadId, StringArena & strings);
+
+        /**
+         * Copies a summary, storing its strings in another arena.
+         */
+        Thread(const Thread & thread, StringArena & strings);
+
+        /* A plain copy would share the strings of the original's arena, so
+         * copies must name an arena to go in */
+        Thread(const Thread &) = delete;
+        Thread & operator=(const Thread &) = delete;
+
+        Thread(Thread && thread) = default;
+        Thread & operator=(Thread && thread) = default;
 
-        void topLevelMessages(std::vector<Message> & messages);
 
         void addTag(std::string tag);
         void removeTag(std::string tag);
 
 
-        std::string id;
-        std::string subject;
-        std::string authors;
+        const char * id;
+        const char * subject;
+        const char * authors;
 
         uint32_t totalMessages;
         uint32_t matchedMessages;
@@ -42,7 +65,7 @@ class Thread
         time_t newestDate;
         time_t oldestDate;
 
-        std::set<std::string> tags;
+        TagSet tags;
 };
 
 #endif /* NER_THREAD_H */
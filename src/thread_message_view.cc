@@ -24,6 +24,8 @@
 #include "notmuch.hh"
 #include "colors.hh"
 #include "line_editor.hh"
+#include "latency_recorder.hh"
+#include "message_prefetcher.hh"
 
 const int threadViewHeight = 8;
 
@@ -75,14 +77,31 @@ void ThreadMessageView::update()
 {
     mvhline(threadViewHeight, 0, 0, COLS);
 
-    _threadView.update();
-    _messageView.update();
+    {
+        LatencyRecorder::Scope scope(_threadView, LatencyRecorder::Event::Update);
+        _threadView.update();
+    }
+
+    {
+        LatencyRecorder::Scope scope(_messageView, LatencyRecorder::Event::Update);
+        _messageView.update();
+    }
 }
 
 void ThreadMessageView::refresh()
 {
-    _threadView.refresh();
-    _messageView.refresh();
+    /* The divider between the views */
+    wnoutrefresh(stdscr);
+
+    {
+        LatencyRecorder::Scope scope(_threadView, LatencyRecorder::Event::Refresh);
+        _threadView.refresh();
+    }
+
+    {
+        LatencyRecorder::Scope scope(_messageView, LatencyRecorder::Event::Refresh);
+        _messageView.refresh();
+    }
 }
 
 void ThreadMessageView::resize(const View::Geometry & geometry)
@@ -94,6 +113,14 @@ void ThreadMessageView::resize(const View::Geometry & geometry)
     });
 }
 
+void ThreadMessageView::focus()
+{
+    View::focus();
+
+    _threadView.focus();
+    _messageView.focus();
+}
+
 void ThreadMessageView::nextMessage()
 {
     _threadView.next();
@@ -110,10 +137,28 @@ void ThreadMessageView::previousMessage()
 
 void ThreadMessageView::loadSelectedMessage()
 {
-    _messageView.setMessage(_threadView.selectedMessage().id);
+    std::string messageId = _threadView.selectedMessage().id();
 
-    Message message = Notmuch::getMessage(_threadView.selectedMessage().id);
-    message.removeTag("unread");
+    _messageView.setMessage(messageId);
+
+    _threadView.tagSelectedMessage({}, { "unread" });
+
+    /* Get the messages likely to be read next ready */
+    std::vector<std::string> filenames;
+
+    const Message * messages[] = {
+        _threadView.adjacentMessage(1),
+        _threadView.adjacentMessage(-1),
+        _threadView.firstUnreadMessage()
+    };
+
+    for (auto message = std::begin(messages), e = std::end(messages); message != e; ++message)
+    {
+        if (*message)
+            filenames.push_back((*message)->filename());
+    }
+
+    MessagePrefetcher::instance().prefetch(filenames);
 }
 
 std::vector<std::string> ThreadMessageView::status() const
@@ -127,34 +172,27 @@ std::vector<std::string> ThreadMessageView::status() const
 
 void ThreadMessageView::markHam()
 {
-    std::string _messageId = _threadView.selectedMessage().id;
-    Message message = Notmuch::getMessage(_messageId);
-    message.addTag("ham");
+    _threadView.tagSelectedMessage({ "ham" }, {});
+
     nextMessage();
 }
 
 void ThreadMessageView::markToggle()
 {
-    std::string _messageId = _threadView.selectedMessage().id;
-    Message message = Notmuch::getMessage(_messageId);
-    message.addTag("toggle");
+    _threadView.tagSelectedMessage({ "toggle" }, {});
+
     nextMessage();
 }
 
 void ThreadMessageView::clearMarks()
 {
-    std::string _messageId = _threadView.selectedMessage().id;
-    Message message = Notmuch::getMessage(_messageId);
-    message.removeTag("ham");
-    message.removeTag("toggle");
+    _threadView.tagSelectedMessage({}, { "ham", "toggle" });
+
     nextMessage();
 }
 
 void ThreadMessageView::addTags()
 {
-    std::string _messageId = _threadView.selectedMessage().id;
-    Message message = Notmuch::getMessage(_messageId);
-
     try
     {
         std::string tags = StatusBar::instance().prompt("Tags: ", "tags");
@@ -162,11 +200,15 @@ void ThreadMessageView::addTags()
         if (!tags.empty()) {
             std::stringstream ss(tags);
             std::string s;
+            std::vector<std::string> addedTags;
 
             while (std::getline(ss, s, ' ')) {
-                message.addTag(s);
+                if (!s.empty())
+                    addedTags.push_back(s);
             }
 
+            _threadView.tagSelectedMessage(addedTags, {});
+
             update();
         }
     }
@@ -177,9 +219,6 @@ void ThreadMessageView::addTags()
 
 void ThreadMessageView::removeTags()
 {
-    std::string _messageId = _threadView.selectedMessage().id;
-    Message message = Notmuch::getMessage(_messageId);
-
     try
     {
         std::string tags = StatusBar::instance().prompt("Tags: ", "tags");
@@ -187,11 +226,15 @@ void ThreadMessageView::removeTags()
         if (!tags.empty()) {
             std::stringstream ss(tags);
             std::string s;
+            std::vector<std::string> removedTags;
 
             while (std::getline(ss, s, ' ')) {
-                message.removeTag(s);
+                if (!s.empty())
+                    removedTags.push_back(s);
             }
 
+            _threadView.tagSelectedMessage({}, removedTags);
+
             update();
         }
     }
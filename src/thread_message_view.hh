@@ -33,6 +33,7 @@ class ThreadMessageView : public View
         virtual void update();
         virtual void refresh();
         virtual void resize(const View::Geometry & geometry = View::Geometry());
+        virtual void focus();
 
         virtual std::string name() const { return "thread-message-view"; }
         virtual std::vector<std::string> status() const;
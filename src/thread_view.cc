@@ -18,7 +18,6 @@
  */
 
 #include <sstream>
-#include <iterator>
 
 #include "thread_view.hh"
 #include "notmuch.hh"
@@ -30,6 +29,8 @@
 #include "status_bar.hh"
 #include "reply_view.hh"
 
+const TagSet::Tag unreadTag = TagSet::intern("unread");
+
 ThreadView::ThreadView(const std::string & threadId, const View::Geometry & geometry)
     : LineBrowserView(geometry), _id(threadId)
 {
@@ -38,14 +39,11 @@ ThreadView::ThreadView(const std::string & threadId, const View::Geometry & geom
     _selectedIndex = 0;
 
     /* Find first unread message */
-    int messageIndex = 0;
-
-    for (Message::const_iterator message(_topMessages.rbegin(), _topMessages.rend()), e;
-        message != e; ++message, ++messageIndex)
+    for (int index = 0; index < _rows.size(); ++index)
     {
-        if (message->tags.find("unread") != message->tags.end())
+        if (_rows[index].unread)
         {
-            _selectedIndex = messageIndex;
+            _selectedIndex = index;
             break;
         }
     }
@@ -63,36 +61,77 @@ ThreadView::~ThreadView()
 
 void ThreadView::refreshMessages()
 {
-    Thread & thread = Notmuch::getThread(_id);
+    notmuch_query_t * query = NULL;
+    notmuch_thread_t * thread = Notmuch::thread(_id, &query);
+
+    /* The messages keep the query alive until they are all gone */
+    std::shared_ptr<void> owner(Notmuch::own(query));
 
-    _messageCount = thread.totalMessages;
-    thread.topLevelMessages(_topMessages);
+    _topMessages.clear();
+    _rows.clear();
+
+    notmuch_messages_t * messages;
+    for (messages = notmuch_thread_get_toplevel_messages(thread);
+        notmuch_messages_valid(messages);
+        notmuch_messages_move_to_next(messages))
+    {
+        _topMessages.push_back(Message(notmuch_messages_get(messages), owner));
+    }
+
+    _rows.reserve(notmuch_thread_get_total_messages(thread));
+
+    std::vector<chtype> leading;
+
+    for (auto message = _topMessages.begin(), e = _topMessages.end(); message != e; ++message)
+        flatten(*message, leading, (message + 1) == e);
+
+    _revision = Notmuch::databaseRevision();
+
+    invalidate();
 }
 
-void ThreadView::update()
+void ThreadView::flatten(Message & message, std::vector<chtype> & leading, bool last)
 {
-    std::vector<chtype> leading;
+    Row row;
 
-    refreshMessages();
-    makeSelectionVisible();
+    row.message = &message;
 
-    werase(_window);
+    row.prefix = leading;
+    row.prefix.push_back(last ? ACS_LLCORNER : ACS_LTEE);
+    row.prefix.push_back('>');
 
-    int index = 0;
+    row.from = message.from();
+    row.date = message.date();
+    row.unread = message.tags().contains(unreadTag);
+    row.tags = message.tags().toString();
 
-    for (auto message = _topMessages.begin(), e = _topMessages.end();
-        message != e && index < getmaxy(_window) + _offset;
-        ++message)
-    {
-        index = displayMessageLine(*message, leading, (message + 1) == e, index);
-    }
+    _rows.push_back(std::move(row));
+
+    leading.push_back(last ? ' ' : ACS_VLINE);
+
+    std::vector<Message> & replies = message.replies();
+
+    for (auto reply = replies.begin(), e = replies.end(); reply != e; ++reply)
+        flatten(*reply, leading, (reply + 1) == e);
+
+    leading.pop_back();
+}
+
+void ThreadView::update()
+{
+    /* Only reload the thread if the database has changed */
+    if (Notmuch::databaseRevision() != _revision)
+        refreshMessages();
+
+    makeSelectionVisible();
+    updateLines();
 }
 
 std::vector<std::string> ThreadView::status() const
 {
     std::ostringstream messagePosition;
 
-    messagePosition << "message " << (_selectedIndex + 1) << " of " << _messageCount;
+    messagePosition << "message " << (_selectedIndex + 1) << " of " << _rows.size();
 
     return std::vector<std::string>{
         "thread:" + _id,
@@ -105,7 +144,7 @@ void ThreadView::openSelectedMessage()
     try
     {
         std::shared_ptr<MessageView> messageView(new MessageView());
-        messageView->setMessage(selectedMessage().id);
+        messageView->setMessage(selectedMessage().id());
         ViewManager::instance().addView(messageView);
     }
     catch (const InvalidMessageException & e)
@@ -116,16 +155,55 @@ void ThreadView::openSelectedMessage()
 
 const Message & ThreadView::selectedMessage() const
 {
-    Message::const_iterator message(_topMessages.rbegin(), _topMessages.rend());
-    std::advance(message, _selectedIndex);
-    return *message;
+    return *_rows.at(_selectedIndex).message;
+}
+
+const Message * ThreadView::adjacentMessage(int offset) const
+{
+    int index = _selectedIndex + offset;
+
+    if (index < 0 || index >= _rows.size())
+        return NULL;
+
+    return _rows[index].message;
+}
+
+const Message * ThreadView::firstUnreadMessage() const
+{
+    for (int index = 0; index < _rows.size(); ++index)
+    {
+        if (_rows[index].unread && index != _selectedIndex)
+            return _rows[index].message;
+    }
+
+    return NULL;
+}
+
+void ThreadView::tagSelectedMessage(const std::vector<std::string> & addedTags,
+    const std::vector<std::string> & removedTags)
+{
+    if (_selectedIndex >= _rows.size())
+        return;
+
+    Row & row = _rows[_selectedIndex];
+
+    for (auto tag = addedTags.begin(), e = addedTags.end(); tag != e; ++tag)
+        row.message->addTag(*tag);
+
+    for (auto tag = removedTags.begin(), e = removedTags.end(); tag != e; ++tag)
+        row.message->removeTag(*tag);
+
+    row.unread = row.message->tags().contains(unreadTag);
+    row.tags = row.message->tags().toString();
+
+    invalidateLine(_selectedIndex);
 }
 
 void ThreadView::reply()
 {
     try
     {
-        ViewManager::instance().addView(std::make_shared<ReplyView>(selectedMessage().id));
+        ViewManager::instance().addView(std::make_shared<ReplyView>(selectedMessage().id()));
     }
     catch (const InvalidMessageException & e)
     {
@@ -135,97 +213,57 @@ void ThreadView::reply()
 
 int ThreadView::lineCount() const
 {
-    return _messageCount;
+    return _rows.size();
 }
 
-uint32_t ThreadView::displayMessageLine(const Message & message,
-    std::vector<chtype> & leading, bool last, int index)
+void ThreadView::displayLine(int index)
 {
-    if (index >= _offset)
-    {
-        try
-        {
-            bool selected = index == _selectedIndex;
-            bool unread = message.tags.find("unread") != message.tags.end();
+    const Row & row = _rows[index];
 
-            int x = 0;
-            int row = index - _offset;
-
-            wmove(_window, row, x);
-
-            attr_t attributes = 0;
-
-            if (selected)
-                attributes |= A_REVERSE;
-
-            if (unread)
-                attributes |= A_BOLD;
-
-            wchgat(_window, -1, attributes, 0, NULL);
+    try
+    {
+        bool selected = index == _selectedIndex;
 
-            x += NCurses::addPlainString(_window, leading.begin(), leading.end(),
-                attributes, ColorID::ThreadViewArrow);
+        int x = 0;
+        int rowIndex = index - _offset;
 
-            NCurses::checkMove(_window, x);
+        wmove(_window, rowIndex, x);
 
-            x += NCurses::addChar(_window, last ? ACS_LLCORNER : ACS_LTEE,
-                attributes, ColorID::ThreadViewArrow);
+        attr_t attributes = 0;
 
-            NCurses::checkMove(_window, x);
+        if (selected)
+            attributes |= A_REVERSE;
 
-            x += NCurses::addChar(_window, '>', attributes, ColorID::ThreadViewArrow);
+        if (row.unread)
+            attributes |= A_BOLD;
 
-            NCurses::checkMove(_window, ++x);
+        wchgat(_window, -1, attributes, 0, NULL);
 
-            /* Sender */
-            x += NCurses::addUtf8String(_window, (*message.headers.find("From")).second.c_str(),
-                attributes);
+        x += NCurses::addPlainString(_window, row.prefix.begin(), row.prefix.end(),
+            attributes, ColorID::ThreadViewArrow);
 
-            NCurses::checkMove(_window, ++x);
+        NCurses::checkMove(_window, ++x);
 
-            /* Date */
-            x += NCurses::addPlainString(_window, relativeTime(message.date),
-                attributes, ColorID::ThreadViewDate);
+        /* Sender */
+        x += NCurses::addCachedUtf8String(_window, row.from.c_str(), attributes);
 
-            NCurses::checkMove(_window, ++x);
+        NCurses::checkMove(_window, ++x);
 
-            /* Tags */
-            std::ostringstream tagStream;
-            std::copy(message.tags.begin(), message.tags.end(),
-                std::ostream_iterator<std::string>(tagStream, " "));
-            std::string tags(tagStream.str());
+        /* Date */
+        x += NCurses::addPlainString(_window, relativeTime(row.date),
+            attributes, ColorID::ThreadViewDate);
 
-            if (tags.size() > 0)
-                /* Get rid of the trailing space */
-                tags.resize(tags.size() - 1);
+        NCurses::checkMove(_window, ++x);
 
-            x += NCurses::addPlainString(_window, tags, attributes, ColorID::ThreadViewTags);
+        /* Tags */
+        x += NCurses::addPlainString(_window, row.tags, attributes, ColorID::ThreadViewTags);
 
-            NCurses::checkMove(_window, x - 1);
-        }
-        catch (const NCurses::CutOffException & e)
-        {
-            NCurses::addCutOffIndicator(_window);
-        }
+        NCurses::checkMove(_window, x - 1);
     }
-
-    ++index;
-
-    if (last)
-        leading.push_back(' ');
-    else
-        leading.push_back(ACS_VLINE);
-
-    for (auto reply = message.replies.begin(), e = message.replies.end();
-        reply != e && index < getmaxy(_window) + _offset;
-        ++reply)
+    catch (const NCurses::CutOffException & e)
     {
-        index = displayMessageLine(*reply, leading, (reply + 1) == e, index);
+        NCurses::addCutOffIndicator(_window);
     }
-
-    leading.pop_back();
-
-    return index;
 }
 
 // vim: fdm=syntax fo=croql et sw=4 sts=4 ts=8
@@ -38,22 +38,70 @@ class ThreadView : public LineBrowserView
         virtual std::vector<std::string> status() const;
 
         const Message & selectedMessage() const;
+
+        /**
+         * Returns the message the given number of lines from the selection.
+         *
+         * \return The message, or NULL if there is none.
+         */
+        const Message * adjacentMessage(int offset) const;
+
+        /**
+         * Returns the first unread message other than the selected one.
+         *
+         * \return The message, or NULL if there is none.
+         */
+        const Message * firstUnreadMessage() const;
+
+        /**
+         * Changes the tags of the selected message, showing the change
+         * straight away, and queues it to be written to the database.
+         */
+        void tagSelectedMessage(const std::vector<std::string> & addedTags,
+            const std::vector<std::string> & removedTags);
         virtual void openSelectedMessage();
 
         void reply();
 
     protected:
         virtual int lineCount() const;
+        virtual void displayLine(int index);
 
         std::string _id;
 
     private:
+        /**
+         * A message in the thread, laid out as a line of the view.
+         */
+        struct Row
+        {
+            Message * message;
+
+            /* The tree lines leading up to the message, and its arrow */
+            std::vector<chtype> prefix;
+
+            std::string from;
+            std::string tags;
+            time_t date;
+            bool unread;
+        };
+
         void refreshMessages();
-        uint32_t displayMessageLine(const Message & message,
-            std::vector<chtype> & leading, bool last, int index);
+
+        /**
+         * Appends the rows for the message and its replies, in display order.
+         *
+         * \param message The message to add.
+         * \param leading The tree lines leading up to the message.
+         * \param last Whether the message is the last of its siblings.
+         */
+        void flatten(Message & message, std::vector<chtype> & leading, bool last);
 
         std::vector<Message> _topMessages;
-        int _messageCount;
+        std::vector<Row> _rows;
+
+        /* The database revision the messages were loaded at */
+        unsigned long _revision;
 };
 
 #endif
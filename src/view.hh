@@ -57,7 +57,10 @@ class View : public InputHandler
         virtual void update() = 0;
 
         /**
-         * Refreshes the screen.
+         * Stages the view's windows for the next frame.
+         *
+         * Nothing reaches the terminal until ViewManager::refresh, which draws
+         * the whole frame at once.
          */
         virtual void refresh() = 0;
 
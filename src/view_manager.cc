@@ -23,6 +23,7 @@
 #include "view.hh"
 #include "view_view.hh"
 #include "status_bar.hh"
+#include "latency_recorder.hh"
 
 ViewManager * ViewManager::_instance = 0;
 
@@ -95,12 +96,16 @@ void ViewManager::closeActiveView()
 
 void ViewManager::update()
 {
+    LatencyRecorder::Scope scope(*_activeView, LatencyRecorder::Event::Update);
     _activeView->update();
 }
 
 void ViewManager::refresh()
 {
+    LatencyRecorder::Scope scope(*_activeView, LatencyRecorder::Event::Refresh);
     _activeView->refresh();
+    StatusBar::instance().refresh();
+    doupdate();
 }
 
 void ViewManager::resize()
@@ -68,6 +68,11 @@ class ViewManager : public InputHandler
         void closeActiveView();
 
         void update();
+
+        /**
+         * Draws a frame: the active view and the status bar, with a single
+         * update of the terminal.
+         */
         void refresh();
         void resize();
 
@@ -34,7 +34,7 @@ WindowView::~WindowView()
 
 void WindowView::refresh()
 {
-    wrefresh(_window);
+    wnoutrefresh(_window);
 }
 
 void WindowView::resize(const View::Geometry & geometry)